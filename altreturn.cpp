@@ -0,0 +1,129 @@
+#include <span>
+
+// An error convention that needs neither a flag nor a register. On error, the callee returns to its return
+// address plus 4. The caller places an 8 byte nop right after the call whose displacement contains a short jump
+// to the error path:
+//    call f
+//    0f 1f 84 00 eb XX 00 00     nopl 0x0000XXeb(%rax,%rax,1)
+// A normal return executes the nop and continues, the error return lands on the eb XX, i.e., on a jmp to the
+// error path. Thus, the happy path contains no test at all, only the error return pays with a mispredicted return.
+
+unsigned herbceptionEmulationSqrt(std::span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationFib(unsigned n, unsigned maxDepth) noexcept;
+
+#if defined(__x86_64__) && defined(__linux__)
+
+// Call target, continue at error when it returns an error. The error path must be within 127 bytes
+#define ALTCALL(target, error) \
+   "callq " target "\n"        \
+   ".byte 0x0f, 0x1f, 0x84, 0x00, 0xeb, " error " - . - 1, 0x00, 0x00\n"
+
+static unsigned doSqrt(double* values, unsigned long count, unsigned repeat) __attribute__((naked));
+static unsigned doSqrt(double* /*values*/, unsigned long /*count*/, unsigned /*repeat*/) {
+   asm(R"(
+        pushq   %rbx
+        pushq   %r12
+        pushq   %r13
+        pushq   %r14
+        movq    %rdi, %r12
+        movq    %rsi, %r13
+        movl    %edx, %ebx
+        xorl    %r14d, %r14d
+        testl   %ebx, %ebx
+        je      .LAsqrt_done
+.LAsqrt_loop:
+        movq    %r12, %rdi
+        movq    %r13, %rsi
+)" ALTCALL(".LAsqrt", ".LAsqrt_failed") R"(
+.LAsqrt_next:
+        decl    %ebx
+        jne     .LAsqrt_loop
+.LAsqrt_done:
+        movl    %r14d, %eax
+        popq    %r14
+        popq    %r13
+        popq    %r12
+        popq    %rbx
+        retq
+.LAsqrt_failed:
+        incl    %r14d
+        jmp     .LAsqrt_next
+
+.LAsqrt:
+        xorpd   %xmm1, %xmm1
+        testq   %rsi, %rsi
+        je      .LAsqrt_ret
+.LAsqrt_value:
+        movsd   (%rdi), %xmm0
+        ucomisd %xmm0, %xmm1
+        ja      .LAsqrt_error
+        sqrtsd  %xmm0, %xmm0
+        movsd   %xmm0, (%rdi)
+        addq    $8, %rdi
+        decq    %rsi
+        jne     .LAsqrt_value
+.LAsqrt_ret:
+        retq
+.LAsqrt_error:
+        addq    $4, (%rsp)
+        retq
+   )");
+}
+
+unsigned altReturnSqrt(std::span<double> values, unsigned repeat) noexcept {
+   return doSqrt(values.data(), values.size(), repeat);
+}
+
+static unsigned doFib(unsigned n, unsigned maxDepth) __attribute__((naked));
+static unsigned doFib(unsigned /*n*/, unsigned /*maxDepth*/) {
+   asm(ALTCALL(".LAfib", ".LAfib_entry_failed") R"(
+        retq
+.LAfib_entry_failed:
+        xorl    %eax, %eax
+        retq
+
+.LAfib:
+        pushq   %rbp
+        pushq   %r14
+        pushq   %rbx
+        testl   %esi, %esi
+        je      .LAfib_error
+        movl    %edi, %r14d
+        movl    $1, %eax
+        cmpl    $3, %edi
+        jb      .LAfib_done
+        movl    %esi, %ebx
+        leal    -2(%r14), %edi
+        decl    %ebx
+        movl    %ebx, %esi
+)" ALTCALL(".LAfib", ".LAfib_error") R"(
+        movl    %eax, %ebp
+        decl    %r14d
+        movl    %r14d, %edi
+        movl    %ebx, %esi
+)" ALTCALL(".LAfib", ".LAfib_error") R"(
+        addl    %ebp, %eax
+.LAfib_done:
+        popq    %rbx
+        popq    %r14
+        popq    %rbp
+        retq
+.LAfib_error:
+        popq    %rbx
+        popq    %r14
+        popq    %rbp
+        addq    $4, (%rsp)
+        retq
+   )");
+}
+
+unsigned altReturnFib(unsigned n, unsigned maxDepth) noexcept {
+   return doFib(n, maxDepth);
+}
+
+#else
+#warning No alternate return implementation provided for this platform, falling back to emulation
+
+unsigned altReturnSqrt(std::span<double> values, unsigned repeat) noexcept { return herbceptionEmulationSqrt(values, repeat); }
+unsigned altReturnFib(unsigned n, unsigned maxDepth) noexcept { return herbceptionEmulationFib(n, maxDepth); }
+#endif
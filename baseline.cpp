@@ -1,3 +1,4 @@
+#include "simdsqrt.hpp"
 #include <cmath>
 #include <exception>
 #include <span>
@@ -16,6 +17,19 @@ unsigned baselineSqrt(std::span<double> values, unsigned repeat) {
    return failures;
 }
 
+// The same with a vectorized kernel
+static void doSimdSqrt(std::span<double> values) noexcept __attribute__((noinline));
+static void doSimdSqrt(std::span<double> values) noexcept {
+   if (!simdSqrt(values)) std::terminate();
+}
+
+unsigned baselineSimdSqrt(std::span<double> values, unsigned repeat) {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index)
+      doSimdSqrt(values);
+   return failures;
+}
+
 static unsigned doFib(unsigned n, unsigned maxDepth) noexcept __attribute__((noinline, optimize("no-optimize-sibling-calls")));
 static unsigned doFib(unsigned n, unsigned maxDepth) noexcept {
    if (!maxDepth) std::terminate();
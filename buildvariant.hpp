@@ -0,0 +1,13 @@
+#ifndef H_buildvariant
+#define H_buildvariant
+
+// Some sources are compiled in several configurations (see the Makefile). Each configuration defines
+// BUILD_VARIANT, which is appended to the exported names to keep the configurations apart
+#ifndef BUILD_VARIANT
+#define BUILD_VARIANT
+#endif
+#define VARIANT_NAME2(name, variant) name##variant
+#define VARIANT_NAME1(name, variant) VARIANT_NAME2(name, variant)
+#define VARIANT_NAME(name) VARIANT_NAME1(name, BUILD_VARIANT)
+
+#endif
@@ -0,0 +1,227 @@
+#include <cmath>
+#include <coroutine>
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <span>
+#include <system_error>
+
+// Error propagation with C++20 coroutines. doSqrt and doFib are coroutines that co_await the results of their
+// callees. Every call allocates a coroutine frame, either on the heap or from a per-thread stack-like arena.
+// Errors are propagated in one of two ways:
+// - per frame: a failing coroutine stores the error in its promise and resumes its caller. The caller finds the
+//   error when its co_await completes and fails in turn, just like a function returning an error code.
+// - root jump: a failing coroutine stores the error at the root of the call chain and never resumes its caller,
+//   which short-circuits directly back to the root in O(1). The suspended frames are destroyed from there. Thus
+//   the happy path contains no error checks at all.
+// Outcome's awaitables are not used here: their promise type cannot be given a custom frame allocator.
+
+namespace {
+
+/// Allocates coroutine frames on the heap
+struct HeapFrames {
+   static void* allocate(std::size_t size) { return ::operator new(size); }
+   static void release(void* p, std::size_t size) noexcept { ::operator delete(p, size); }
+};
+
+/// Allocates coroutine frames from a per-thread arena. Frames are released in reverse order of allocation,
+/// which allows for managing the arena like a stack. Falls back to the heap when the arena is exhausted
+struct ArenaFrames {
+   /// The arena of a thread
+   struct Arena {
+      /// The size of the arena
+      static constexpr std::size_t arenaSize = 64 * 1024;
+      /// The memory
+      alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) char memory[arenaSize];
+      /// The top of the stack
+      std::size_t top = 0;
+   };
+   /// The arena of the current thread
+   static thread_local Arena arena;
+
+   /// Round up to the alignment of the arena
+   static constexpr std::size_t align(std::size_t size) { return (size + __STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1) & ~(__STDCPP_DEFAULT_NEW_ALIGNMENT__ - 1); }
+
+   static void* allocate(std::size_t size) {
+      auto& a = arena;
+      size = align(size);
+      if (a.top + size > Arena::arenaSize) return ::operator new(size);
+      void* result = a.memory + a.top;
+      a.top += size;
+      return result;
+   }
+   static void release(void* p, std::size_t size) noexcept {
+      auto& a = arena;
+      auto c = static_cast<char*>(p);
+      if ((c < a.memory) || (c >= a.memory + Arena::arenaSize)) {
+         ::operator delete(p, align(size));
+         return;
+      }
+      // Frames are released in LIFO order, thus this is always the top-most frame
+      a.top = c - a.memory;
+   }
+};
+thread_local ArenaFrames::Arena ArenaFrames::arena;
+
+/// Resumes the awaiting coroutine when a coroutine completes
+struct FinalAwaiter {
+   bool await_ready() noexcept { return false; }
+   template <class Promise>
+   std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> self) noexcept { return self.promise().continuation; }
+   void await_resume() noexcept {}
+};
+
+/// The state shared by all promise types
+struct PromiseBase {
+   /// The coroutine that awaits us
+   std::coroutine_handle<> continuation;
+   /// The error of this coroutine, used with per frame propagation
+   std::error_code error;
+   /// The error slot of the root, used with root jumps
+   std::error_code* rootError = nullptr;
+
+   std::suspend_always initial_suspend() noexcept { return {}; }
+   FinalAwaiter final_suspend() noexcept { return {}; }
+   void unhandled_exception() noexcept { abort(); }
+};
+
+/// Stores the result value
+template <class T>
+struct PromiseValue : PromiseBase {
+   T value;
+   void return_value(T v) noexcept { value = v; }
+   T result() noexcept { return value; }
+};
+template <>
+struct PromiseValue<void> : PromiseBase {
+   void return_void() noexcept {}
+   void result() noexcept {}
+};
+
+/// The outcome of awaiting a task
+template <class T>
+struct Completion {
+   /// The value, if the task succeeded
+   T value;
+   /// The error, if the task failed
+   std::error_code error;
+};
+
+/// A lazily started coroutine producing a T or an error
+template <class T, class Frames, bool rootJump>
+class [[nodiscard]] Task {
+   public:
+   struct promise_type : PromiseValue<T> {
+      static constexpr bool rootJumps = rootJump;
+      Task get_return_object() noexcept { return Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+      static void* operator new(std::size_t size) { return Frames::allocate(size); }
+      static void operator delete(void* p, std::size_t size) noexcept { Frames::release(p, size); }
+   };
+
+   private:
+   /// The coroutine
+   std::coroutine_handle<promise_type> handle;
+
+   /// Constructor
+   explicit Task(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+   public:
+   /// Move constructor
+   Task(Task&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+   /// Destructor. Destroys the frame, and with it all frames of suspended callees
+   ~Task() {
+      if (handle) handle.destroy();
+   }
+
+   /// Await the task. With root jumps the awaiting coroutine is not resumed if the task fails, thus the completion
+   /// never carries an error and the check of the caller folds away
+   bool await_ready() noexcept { return false; }
+   template <class Promise>
+   std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> caller) noexcept {
+      handle.promise().continuation = caller;
+      if constexpr (rootJump) handle.promise().rootError = caller.promise().rootError;
+      return handle;
+   }
+   Completion<T> await_resume() noexcept {
+      auto& p = handle.promise();
+      if (!rootJump && p.error) [[unlikely]] return {{}, p.error};
+      return {p.result(), {}};
+   }
+
+   /// Run the task to completion from regular code. Returns false if it failed
+   bool run(std::error_code& error) noexcept {
+      handle.promise().continuation = std::noop_coroutine();
+      handle.promise().rootError = &error;
+      handle.resume();
+      if constexpr (!rootJump) error = handle.promise().error;
+      return !error;
+   }
+   /// Get the result after a successful run
+   T result() noexcept { return handle.promise().result(); }
+};
+
+/// Fail the current coroutine. Never resumes, control continues at the caller or at the root
+struct Raise {
+   std::error_code e;
+
+   bool await_ready() noexcept { return false; }
+   template <class Promise>
+   std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> self) noexcept {
+      if constexpr (Promise::rootJumps) {
+         *self.promise().rootError = e;
+         return std::noop_coroutine();
+      } else {
+         self.promise().error = e;
+         return self.promise().continuation;
+      }
+   }
+   void await_resume() noexcept {}
+};
+
+template <class Frames, bool rootJump>
+static Task<void, Frames, rootJump> doSqrt(std::span<double> values) {
+   for (auto& v : values) {
+      if (v < 0) co_await Raise{std::make_error_code(std::errc::argument_out_of_domain)};
+      v = sqrt(v);
+   }
+}
+
+template <class Frames, bool rootJump>
+static unsigned sqrtImpl(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      std::error_code error;
+      if (!doSqrt<Frames, rootJump>(values).run(error)) ++failures;
+   }
+   return failures;
+}
+
+template <class Frames, bool rootJump>
+static Task<unsigned, Frames, rootJump> doFib(unsigned n, unsigned maxDepth) {
+   if (!maxDepth) co_await Raise{std::make_error_code(std::errc::argument_out_of_domain)};
+   if (n <= 2) co_return 1;
+   // The checks fold away with root jumps. GCC 12 cannot co_await inside a statement expression, thus no TRY macro
+   auto n2 = co_await doFib<Frames, rootJump>(n - 2, maxDepth - 1);
+   if (n2.error) [[unlikely]] co_await Raise{n2.error};
+   auto n1 = co_await doFib<Frames, rootJump>(n - 1, maxDepth - 1);
+   if (n1.error) [[unlikely]] co_await Raise{n1.error};
+   co_return n2.value + n1.value;
+}
+
+template <class Frames, bool rootJump>
+static unsigned fibImpl(unsigned n, unsigned maxDepth) noexcept {
+   std::error_code error;
+   auto task = doFib<Frames, rootJump>(n, maxDepth);
+   return task.run(error) ? task.result() : 0;
+}
+
+}
+
+unsigned coroutineSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<HeapFrames, false>(values, repeat); }
+unsigned coroutineFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<HeapFrames, false>(n, maxDepth); }
+unsigned coroutineArenaSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<ArenaFrames, false>(values, repeat); }
+unsigned coroutineArenaFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<ArenaFrames, false>(n, maxDepth); }
+unsigned coroutineRootJumpSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<HeapFrames, true>(values, repeat); }
+unsigned coroutineRootJumpFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<HeapFrames, true>(n, maxDepth); }
+unsigned coroutineArenaRootJumpSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<ArenaFrames, true>(values, repeat); }
+unsigned coroutineArenaRootJumpFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<ArenaFrames, true>(n, maxDepth); }
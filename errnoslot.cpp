@@ -0,0 +1,135 @@
+#include <cmath>
+#include <span>
+#include <system_error>
+
+// Reports errors like errno does: functions return plain values and store the error in a thread-local slot,
+// which the caller checks after every call. The cost of accessing the slot depends on the TLS model, thus the
+// file is compiled twice:
+// - into the executable (bin/errnoslot.o). The direct access becomes a local-exec access, because the linker
+//   relaxes every access within an executable. A second variant goes through an out-of-line accessor, like errno
+//   itself does with __errno_location.
+// - into a shared library (bin/liberrnoslot.so, ERRNOSLOT_SHARED) that bin/runtests links against. Here the
+//   accesses stay as compiled: initial-exec loads the offset of the slot from the GOT, general-dynamic calls
+//   __tls_get_addr for every access.
+
+/// The error slot
+struct ErrorSlot {
+   /// The error value, 0 if no error
+   int value;
+   /// The category
+   const std::error_category* category;
+};
+
+#ifdef ERRNOSLOT_SHARED
+/// The error slots of the current thread. Exported, thus the compiler cannot resort to a local-dynamic access
+thread_local ErrorSlot errnoSlotInitialExec __attribute__((tls_model("initial-exec")));
+thread_local ErrorSlot errnoSlotGeneralDynamic __attribute__((tls_model("global-dynamic")));
+#endif
+
+namespace {
+
+#ifdef ERRNOSLOT_SHARED
+/// Access the initial-exec slot
+struct InitialExecAccess {
+   static ErrorSlot& slot() noexcept { return errnoSlotInitialExec; }
+};
+
+/// Access the general-dynamic slot
+struct GeneralDynamicAccess {
+   static ErrorSlot& slot() noexcept { return errnoSlotGeneralDynamic; }
+};
+#else
+/// The error slot of the current thread
+static thread_local ErrorSlot errorSlot __attribute__((tls_model("initial-exec")));
+
+/// Access the error slot directly
+struct DirectAccess {
+   static ErrorSlot& slot() noexcept { return errorSlot; }
+};
+
+/// Get the error slot of the current thread
+static ErrorSlot* errorSlotLocation() noexcept __attribute__((noinline, noipa));
+static ErrorSlot* errorSlotLocation() noexcept { return &errorSlot; }
+
+/// Access the error slot through an accessor function
+struct AccessorAccess {
+   static ErrorSlot& slot() noexcept { return *errorSlotLocation(); }
+};
+#endif
+
+/// Report an error
+template <class Access>
+static void setError(std::errc e) noexcept {
+   auto& slot = Access::slot();
+   slot.value = static_cast<int>(e);
+   slot.category = &std::generic_category();
+}
+
+/// Did the last call fail?
+template <class Access>
+static bool failed() noexcept { return Access::slot().value; }
+
+/// Check for an error and clear it
+template <class Access>
+static bool consumeError() noexcept {
+   auto& slot = Access::slot();
+   if (!slot.value) return false;
+   slot.value = 0;
+   return true;
+}
+
+template <class Access>
+static void doSqrt(std::span<double> values) noexcept __attribute__((noinline));
+template <class Access>
+static void doSqrt(std::span<double> values) noexcept {
+   for (auto& v : values) {
+      if (v < 0) return setError<Access>(std::errc::argument_out_of_domain);
+      v = sqrt(v);
+   }
+}
+
+template <class Access>
+static unsigned sqrtImpl(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      doSqrt<Access>(values);
+      if (consumeError<Access>()) ++failures;
+   }
+   return failures;
+}
+
+template <class Access>
+static unsigned doFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <class Access>
+static unsigned doFib(unsigned n, unsigned maxDepth) noexcept {
+   if (!maxDepth) {
+      setError<Access>(std::errc::argument_out_of_domain);
+      return 0;
+   }
+   if (n <= 2) return 1;
+   unsigned a = doFib<Access>(n - 2, maxDepth - 1);
+   if (failed<Access>()) return 0;
+   unsigned b = doFib<Access>(n - 1, maxDepth - 1);
+   if (failed<Access>()) return 0;
+   return a + b;
+}
+
+template <class Access>
+static unsigned fibImpl(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doFib<Access>(n, maxDepth);
+   return consumeError<Access>() ? 0 : v;
+}
+
+}
+
+#ifdef ERRNOSLOT_SHARED
+unsigned errnoSlotInitialExecSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<InitialExecAccess>(values, repeat); }
+unsigned errnoSlotInitialExecFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<InitialExecAccess>(n, maxDepth); }
+unsigned errnoSlotGeneralDynamicSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<GeneralDynamicAccess>(values, repeat); }
+unsigned errnoSlotGeneralDynamicFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<GeneralDynamicAccess>(n, maxDepth); }
+#else
+unsigned errnoSlotSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<DirectAccess>(values, repeat); }
+unsigned errnoSlotFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<DirectAccess>(n, maxDepth); }
+unsigned errnoSlotAccessorSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<AccessorAccess>(values, repeat); }
+unsigned errnoSlotAccessorFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<AccessorAccess>(n, maxDepth); }
+#endif
@@ -0,0 +1,77 @@
+#include "thirdparty/tbv/tbv.hpp"
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <span>
+
+// Classifying errors. The callee can fail with different errors, and the caller reacts depending on which error
+// it got. With std::error_code, the caller compares against std::errc conditions, which goes through the virtual
+// equivalent functions of the categories. With an integer domain, the caller compares two integers.
+
+namespace {
+
+/// Errors as std::error_code
+struct CategoryErrors {
+   static tbv::detail::errorresult raise(std::errc e) noexcept { return tbv::throw_value(std::make_error_code(e)); }
+   template <class R>
+   static bool is(const R& r, std::errc e) noexcept { return r.error() == e; }
+};
+
+/// Errors of an integer domain
+struct DomainErrors {
+   static tbv::detail::errorresult raise(std::errc e) noexcept { return tbv::throw_value(tbv::generic_domain, static_cast<int>(e)); }
+   template <class R>
+   static bool is(const R& r, std::errc e) noexcept { return tbv::error_is(r, tbv::generic_domain, static_cast<int>(e)); }
+};
+
+template <class Errors>
+static tbv::result<void> doSqrt(std::span<double> values) noexcept __attribute__((noinline));
+template <class Errors>
+static tbv::result<void> doSqrt(std::span<double> values) noexcept {
+   for (auto& v : values) {
+      if (v < 0) return Errors::raise(std::errc::argument_out_of_domain);
+      if (std::isinf(v)) return Errors::raise(std::errc::result_out_of_range);
+      v = sqrt(v);
+   }
+   return {};
+}
+
+template <class Errors>
+static unsigned sqrtImpl(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      auto r = doSqrt<Errors>(values);
+      if (r.has_error()) {
+         if (Errors::is(r, std::errc::result_out_of_range)) abort();
+         if (Errors::is(r, std::errc::argument_out_of_domain)) ++failures;
+      }
+   }
+   return failures;
+}
+
+template <class Errors>
+static tbv::result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <class Errors>
+static tbv::result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept {
+   if (!maxDepth) return Errors::raise(std::errc::argument_out_of_domain);
+   if (n <= 2) return 1;
+   return TRY(doFib<Errors>(n - 2, maxDepth - 1)) + TRY(doFib<Errors>(n - 1, maxDepth - 1));
+}
+
+template <class Errors>
+static unsigned fibImpl(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doFib<Errors>(n, maxDepth);
+   if (v.has_error()) {
+      if (Errors::is(v, std::errc::result_out_of_range)) abort();
+      if (Errors::is(v, std::errc::argument_out_of_domain)) return 0;
+      abort();
+   }
+   return v.value();
+}
+
+}
+
+unsigned classifyCategorySqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<CategoryErrors>(values, repeat); }
+unsigned classifyCategoryFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<CategoryErrors>(n, maxDepth); }
+unsigned classifyDomainSqrt(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<DomainErrors>(values, repeat); }
+unsigned classifyDomainFib(unsigned n, unsigned maxDepth) noexcept { return fibImpl<DomainErrors>(n, maxDepth); }
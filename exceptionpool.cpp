@@ -0,0 +1,210 @@
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <cxxabi.h>
+#include <exception>
+#include <mutex>
+#include <span>
+#include <unwind.h>
+
+// Replaces the allocation of exception objects. libstdc++ calls malloc for every thrown exception, which
+// touches the global allocator. When pooling is enabled for a thread, exception objects come from
+// thread-local freelists per size class instead. The pooled blocks live in a reserved address range, so that
+// freeing can tell them apart. Everything else is forwarded to the original functions of libstdc++, including
+// its emergency pool, so the regular exceptions method still measures the stock allocator.
+
+#if defined(__GLIBCXX__) && !defined(__ARM_EABI_UNWINDER__) && defined(__linux__)
+#include <dlfcn.h>
+#include <sys/mman.h>
+
+namespace {
+
+/// Mirrors __cxa_exception from libstdc++, we only need its size
+struct CxaException {
+   void* fields[10];
+   _Unwind_Exception unwindHeader;
+};
+/// Mirrors __cxa_refcounted_exception from libstdc++
+struct CxaRefcountedException {
+   int referenceCount;
+   CxaException exc;
+};
+
+/// Precedes every pooled block, tells __cxa_free_exception the size class
+struct alignas(__BIGGEST_ALIGNMENT__) BlockHeader {
+   unsigned sizeClass;
+};
+
+/// The number of pooled size classes. Class i holds blocks of minBlockSize << i bytes
+constexpr unsigned sizeClassCount = 4;
+/// The smallest block size
+constexpr size_t minBlockSize = 256;
+
+/// A cached block
+struct FreeBlock {
+   FreeBlock* next;
+};
+
+/// The address range of the pooled blocks. Blocks are carved out once and then recycled through the freelists
+class Arena {
+   /// The reserved size. Pages are only committed when touched
+   static constexpr size_t arenaSize = size_t(64) << 20;
+
+   /// The memory
+   char* memory = nullptr;
+   /// The bytes carved out so far
+   std::atomic<size_t> used{0};
+   /// Blocks of exited threads
+   FreeBlock* orphans[sizeClassCount] = {};
+   /// Protects orphans
+   std::mutex mutex;
+
+   public:
+   /// Constructor
+   Arena() {
+      void* m = mmap(nullptr, arenaSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+      if (m != MAP_FAILED) memory = static_cast<char*>(m);
+   }
+
+   /// Does a block belong to the arena?
+   bool contains(const void* block) const { return memory && (static_cast<const char*>(block) >= memory) && (static_cast<const char*>(block) < memory + arenaSize); }
+   /// Get a new block, nullptr if the arena is exhausted
+   void* allocate(unsigned sizeClass) {
+      {
+         std::unique_lock lock(mutex);
+         if (auto block = orphans[sizeClass]) {
+            orphans[sizeClass] = block->next;
+            return block;
+         }
+      }
+      if (!memory) return nullptr;
+      size_t size = minBlockSize << sizeClass, offset = used.fetch_add(size);
+      if (offset + size > arenaSize) return nullptr;
+      return memory + offset;
+   }
+   /// Take over the blocks of an exiting thread
+   void adopt(unsigned sizeClass, FreeBlock* first, FreeBlock* last) {
+      std::unique_lock lock(mutex);
+      last->next = orphans[sizeClass];
+      orphans[sizeClass] = first;
+   }
+};
+
+/// The arena
+static Arena arena;
+
+/// The per-thread pool
+class ThreadPool {
+   /// The freelists
+   FreeBlock* freeLists[sizeClassCount] = {};
+
+   public:
+   /// Is pooling enabled for this thread?
+   bool enabled = false;
+
+   /// Destructor
+   ~ThreadPool() {
+      for (unsigned sizeClass = 0; sizeClass != sizeClassCount; ++sizeClass)
+         if (auto first = freeLists[sizeClass]) {
+            auto last = first;
+            while (last->next) last = last->next;
+            arena.adopt(sizeClass, first, last);
+         }
+   }
+
+   /// Get a block
+   void* pop(unsigned sizeClass) {
+      auto block = freeLists[sizeClass];
+      if (!block) return arena.allocate(sizeClass);
+      freeLists[sizeClass] = block->next;
+      return block;
+   }
+   /// Return a block to the freelist
+   void push(unsigned sizeClass, void* block) {
+      auto b = static_cast<FreeBlock*>(block);
+      b->next = freeLists[sizeClass];
+      freeLists[sizeClass] = b;
+   }
+};
+
+/// The pool of the current thread. Blocks freed by a different thread migrate into that thread's pool
+static thread_local ThreadPool threadPool;
+
+/// Find the size class for a block size
+static unsigned sizeClassFor(size_t size) {
+   unsigned sizeClass = 0;
+   while ((sizeClass != sizeClassCount) && (size > (minBlockSize << sizeClass))) ++sizeClass;
+   return sizeClass;
+}
+
+/// The original functions of libstdc++
+struct Originals {
+   void* (*allocate)(size_t) noexcept;
+   void (*free)(void*) noexcept;
+
+   Originals() {
+      allocate = reinterpret_cast<decltype(allocate)>(dlsym(RTLD_NEXT, "__cxa_allocate_exception"));
+      free = reinterpret_cast<decltype(free)>(dlsym(RTLD_NEXT, "__cxa_free_exception"));
+      if (!allocate || !free) std::abort();
+   }
+   static const Originals& get() {
+      static const Originals originals;
+      return originals;
+   }
+};
+
+}
+
+extern "C" {
+
+/// Allocate an exception object
+void* __cxa_allocate_exception(size_t thrownSize) noexcept {
+   if (threadPool.enabled) {
+      size_t size = sizeof(BlockHeader) + sizeof(CxaRefcountedException) + thrownSize;
+      unsigned sizeClass = sizeClassFor(size);
+      if (sizeClass != sizeClassCount)
+         if (void* block = threadPool.pop(sizeClass)) {
+            static_cast<BlockHeader*>(block)->sizeClass = sizeClass;
+            auto header = static_cast<char*>(block) + sizeof(BlockHeader);
+            memset(header, 0, sizeof(CxaRefcountedException));
+            return header + sizeof(CxaRefcountedException);
+         }
+   }
+   return Originals::get().allocate(thrownSize);
+}
+
+/// Free an exception object
+void __cxa_free_exception(void* object) noexcept {
+   if (arena.contains(object)) {
+      auto block = static_cast<char*>(object) - sizeof(CxaRefcountedException) - sizeof(BlockHeader);
+      threadPool.push(reinterpret_cast<BlockHeader*>(block)->sizeClass, block);
+      return;
+   }
+   Originals::get().free(object);
+}
+}
+
+/// Enables pooling for the current thread while alive
+class PoolingScope {
+   public:
+   PoolingScope() { threadPool.enabled = true; }
+   ~PoolingScope() { threadPool.enabled = false; }
+};
+#else
+#warning No exception pool implementation provided for this platform, exceptions-pooled uses the default allocation
+
+class PoolingScope {};
+#endif
+
+unsigned exceptionsSqrt(std::span<double> values, unsigned repeat);
+unsigned exceptionsFib(unsigned n, unsigned maxDepth);
+
+unsigned exceptionsPooledSqrt(std::span<double> values, unsigned repeat) {
+   PoolingScope scope;
+   return exceptionsSqrt(values, repeat);
+}
+
+unsigned exceptionsPooledFib(unsigned n, unsigned maxDepth) {
+   PoolingScope scope;
+   return exceptionsFib(n, maxDepth);
+}
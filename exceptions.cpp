@@ -1,3 +1,5 @@
+#include "simdsqrt.hpp"
+#include "sizedvalue.hpp"
 #include <cmath>
 #include <span>
 
@@ -21,6 +23,22 @@ unsigned exceptionsSqrt(std::span<double> values, unsigned repeat) {
    return failures;
 }
 
+// The same with a vectorized kernel, which raises the error once for all values
+static void doSimdSqrt(std::span<double> values) __attribute__((noinline));
+static void doSimdSqrt(std::span<double> values) {
+   if (!simdSqrt(values)) throw InvalidValue{};
+}
+
+unsigned exceptionsSimdSqrt(std::span<double> values, unsigned repeat) {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      try {
+         doSimdSqrt(values);
+      } catch (const InvalidValue& v) { ++failures; }
+   }
+   return failures;
+}
+
 // prevent the compile from recognizing and compiling away the fib logic
 static unsigned doFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("-O1")));
 
@@ -35,3 +53,23 @@ unsigned exceptionsFib(unsigned n, unsigned maxDepth) {
       return doFib(n, maxDepth);
    } catch (const InvalidValue&) { return 0; }
 }
+
+// Unlike doFib, this is not compiled with -O1. At -O1 the sized values are assembled in memory and reloaded with
+// wider loads, which stalls on store forwarding and would dominate the measurement
+template <unsigned size>
+static SizedValue<size> doSizedFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("no-optimize-sibling-calls")));
+
+template <unsigned size>
+static SizedValue<size> doSizedFib(unsigned n, unsigned maxDepth) {
+   if (!maxDepth) throw InvalidValue();
+   if (n <= 2) return makeSizedValue<SizedValue<size>>(1);
+   return makeSizedValue<SizedValue<size>>(doSizedFib<size>(n - 2, maxDepth - 1).value + doSizedFib<size>(n - 1, maxDepth - 1).value);
+}
+
+unsigned exceptionsSizedFib(unsigned size, unsigned n, unsigned maxDepth) {
+   return dispatchResultSize(size, [&]<unsigned s>() -> unsigned {
+      try {
+         return doSizedFib<s>(n, maxDepth).value;
+      } catch (const InvalidValue&) { return 0; }
+   });
+}
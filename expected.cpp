@@ -1,5 +1,10 @@
 #include "thirdparty/expected/Expected.h"
+#include "thirdparty/tbv/tbv.hpp"
+#include "simdsqrt.hpp"
+#include "sizedvalue.hpp"
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <span>
 
 using namespace std::experimental;
@@ -15,7 +20,7 @@ static expected<void, InvalidValue> doSqrt(std::span<double> values) {
    return {};
 }
 
-unsigned expectedSqrt(std::span<double> values, unsigned repeat) {
+unsigned expectedSqrt(std::span<double> values, unsigned repeat) noexcept {
    unsigned failures = 0;
    for (unsigned index = 0; index != repeat; ++index) {
       if (!doSqrt(values)) ++failures;
@@ -23,6 +28,59 @@ unsigned expectedSqrt(std::span<double> values, unsigned repeat) {
    return failures;
 }
 
+// The same with a vectorized kernel, which raises the error once for all values
+static expected<void, InvalidValue> doSimdSqrt(std::span<double> values) __attribute__((noinline));
+static expected<void, InvalidValue> doSimdSqrt(std::span<double> values) {
+   if (!simdSqrt(values)) return unexpected<InvalidValue>(InvalidValue{});
+   return {};
+}
+
+unsigned expectedSimdSqrt(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      if (!doSimdSqrt(values)) ++failures;
+   }
+   return failures;
+}
+
+// Processing the values as a batch. A failure reports its position, and the caller resumes after the failing value.
+// Like tbv::batch_result, positions and counts are 32 bit to keep the result small, larger inputs are split into
+// batches of at most tbv::max_batch_size values
+
+/// The failure of a batch
+struct BatchFailure {
+   /// The position of the failing value
+   uint32_t position;
+   /// The error
+   InvalidValue error;
+};
+
+static expected<uint32_t, BatchFailure> doBatchSqrt(std::span<double> values) __attribute__((noinline));
+static expected<uint32_t, BatchFailure> doBatchSqrt(std::span<double> values) {
+   for (size_t index = 0; index != values.size(); ++index) {
+      auto& v = values[index];
+      if (v < 0) return unexpected<BatchFailure>(BatchFailure{static_cast<uint32_t>(index), InvalidValue{}});
+      v = sqrt(v);
+   }
+   return static_cast<uint32_t>(values.size());
+}
+
+unsigned expectedBatchSqrt(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      for (auto rest = values; !rest.empty();) {
+         auto r = doBatchSqrt(rest.first(std::min<size_t>(rest.size(), tbv::max_batch_size)));
+         if (r) {
+            rest = rest.subspan(*r);
+         } else {
+            ++failures;
+            rest = rest.subspan(r.error().position + 1);
+         }
+      }
+   }
+   return failures;
+}
+
 static expected<unsigned, InvalidValue> doFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("no-optimize-sibling-calls")));
 static expected<unsigned, InvalidValue> doFib(unsigned n, unsigned maxDepth) {
    if (!maxDepth) return unexpected<InvalidValue>(InvalidValue{});
@@ -34,8 +92,29 @@ static expected<unsigned, InvalidValue> doFib(unsigned n, unsigned maxDepth) {
    return n2.value() + n1.value();
 }
 
-unsigned expectedFib(unsigned n, unsigned maxDepth) {
+unsigned expectedFib(unsigned n, unsigned maxDepth) noexcept {
    auto r = doFib(n, maxDepth);
    if (!r) return 0;
    return r.value();
 }
+
+template <unsigned size>
+static expected<SizedValue<size>, InvalidValue> doSizedFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <unsigned size>
+static expected<SizedValue<size>, InvalidValue> doSizedFib(unsigned n, unsigned maxDepth) {
+   if (!maxDepth) return unexpected<InvalidValue>(InvalidValue{});
+   if (n <= 2) return makeSizedValue<SizedValue<size>>(1);
+   auto n2 = doSizedFib<size>(n - 2, maxDepth - 1);
+   if (!n2) return unexpected<InvalidValue>(n2.error());
+   auto n1 = doSizedFib<size>(n - 1, maxDepth - 1);
+   if (!n1) return unexpected<InvalidValue>(n1.error());
+   return makeSizedValue<SizedValue<size>>(n2.value().value + n1.value().value);
+}
+
+unsigned expectedSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept {
+   return dispatchResultSize(size, [&]<unsigned s>() -> unsigned {
+      auto r = doSizedFib<s>(n, maxDepth);
+      if (!r) return 0;
+      return r.value().value;
+   });
+}
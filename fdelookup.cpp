@@ -0,0 +1,557 @@
+#if defined(__linux__)
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <vector>
+#include <dlfcn.h>
+#include <link.h>
+
+// An in-tree replacement for the FDE lookup of the unwinder. libgcc searches the unwind tables
+// while holding global locks, which serializes concurrent unwinding. Here we keep all PT_GNU_EH_FRAME
+// ranges in a b-tree with optimistic lock coupling, lookups never write to shared memory.
+// The tree is only modified when shared libraries are opened or closed.
+// Optionally, a per-thread cache from pc to FDE sits in front of both lookup paths.
+
+namespace {
+
+/// The bases reported by _Unwind_Find_FDE, mirrors the libgcc definition
+struct dwarf_eh_bases {
+   void* tbase;
+   void* dbase;
+   void* func;
+};
+
+using FindFDEFunction = const void* (*)(void*, dwarf_eh_bases*);
+
+/// The original lookup function, used whenever we cannot handle a lookup ourselves
+static FindFDEFunction originalFindFDE() {
+   static FindFDEFunction func = reinterpret_cast<FindFDEFunction>(dlsym(RTLD_NEXT, "_Unwind_Find_FDE"));
+   return func;
+}
+
+/// A lock that supports optimistic readers. The lowest bit marks an exclusive lock, every unlock changes the version
+class VersionLock {
+   std::atomic<uintptr_t> version{0};
+
+   public:
+   /// Start an optimistic read. Fails if the lock is currently held exclusively
+   bool lockOptimistic(uintptr_t& v) const {
+      v = version.load(std::memory_order_acquire);
+      return !(v & 1);
+   }
+   /// Check that nothing changed since lockOptimistic
+   bool validate(uintptr_t v) const {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      return version.load(std::memory_order_relaxed) == v;
+   }
+   /// Lock exclusively. Writers are serialized externally, thus we never have to wait here
+   void lockExclusive() {
+      version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+   }
+   /// Release the exclusive lock
+   void unlockExclusive() { version.store(version.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+};
+
+/// An executable range together with its unwind table
+struct Entry {
+   uintptr_t begin, end;
+   const unsigned char* ehFrameHdr;
+};
+
+/// The maximum number of entries or children per node
+constexpr unsigned fanout = 15;
+
+/// A b-tree node. Inner nodes route by separators, all entries in child i end at or before separators[i],
+/// and all entries in child i+1 start at or after it
+struct Node {
+   VersionLock lock;
+   bool leaf;
+   unsigned count = 0;
+   union {
+      struct {
+         uintptr_t separators[fanout - 1];
+         Node* children[fanout];
+      } inner;
+      Entry entries[fanout];
+   };
+
+   explicit Node(bool leaf) : leaf(leaf) {}
+};
+
+/// A b-tree with optimistic lock coupling. Readers validate every node they looked at, writers must hold
+/// the registry mutex. Nodes are never freed, a reader might still be looking at them
+class Btree {
+   std::atomic<Node*> root{nullptr};
+
+   /// Split a full node, the caller must hold the lock of the node. Returns the new right half
+   static Node* split(Node* node, uintptr_t& separator);
+
+   public:
+   /// Find the entry containing pc
+   bool lookup(uintptr_t pc, Entry& result) const;
+   /// Insert a new entry
+   void insert(const Entry& entry);
+   /// Remove the entry starting at begin
+   void remove(uintptr_t begin);
+};
+
+Node* Btree::split(Node* node, uintptr_t& separator) {
+   Node* right = new Node(node->leaf);
+   unsigned half = node->count / 2;
+   if (node->leaf) {
+      separator = node->entries[half - 1].end;
+      right->count = node->count - half;
+      std::copy(node->entries + half, node->entries + node->count, right->entries);
+   } else {
+      separator = node->inner.separators[half - 1];
+      right->count = node->count - half;
+      std::copy(node->inner.children + half, node->inner.children + node->count, right->inner.children);
+      std::copy(node->inner.separators + half, node->inner.separators + node->count - 1, right->inner.separators);
+   }
+   node->count = half;
+   return right;
+}
+
+bool Btree::lookup(uintptr_t pc, Entry& result) const {
+restart:
+   Node* node = root.load(std::memory_order_acquire);
+   if (!node) return false;
+   uintptr_t version;
+   if (!node->lock.lockOptimistic(version)) goto restart;
+   if (node != root.load(std::memory_order_relaxed)) goto restart;
+
+   // Descend to the leaf, validating the parent after locking the child
+   while (!node->leaf) {
+      unsigned count = std::min(node->count, fanout), slot = 0;
+      while ((slot + 1 < count) && (pc >= node->inner.separators[slot])) ++slot;
+      Node* child = node->inner.children[slot];
+      if (!node->lock.validate(version)) goto restart;
+      uintptr_t childVersion;
+      if (!child->lock.lockOptimistic(childVersion)) goto restart;
+      if (!node->lock.validate(version)) goto restart;
+      node = child;
+      version = childVersion;
+   }
+
+   // Search within the leaf
+   bool found = false;
+   unsigned count = std::min(node->count, fanout);
+   for (unsigned slot = 0; slot != count; ++slot) {
+      const Entry& e = node->entries[slot];
+      if (pc < e.begin) break;
+      if (pc < e.end) {
+         result = e;
+         found = true;
+         break;
+      }
+   }
+   if (!node->lock.validate(version)) goto restart;
+   return found;
+}
+
+void Btree::insert(const Entry& entry) {
+   Node* node = root.load(std::memory_order_relaxed);
+   if (!node) {
+      node = new Node(true);
+      node->entries[0] = entry;
+      node->count = 1;
+      root.store(node, std::memory_order_release);
+      return;
+   }
+
+   // Descend and split full nodes eagerly, thus the parent always has room for a new child
+   Node* parent = nullptr;
+   unsigned parentSlot = 0;
+   while (true) {
+      if (node->count == fanout) {
+         bool hadParent = parent;
+         if (hadParent) parent->lock.lockExclusive();
+         node->lock.lockExclusive();
+         uintptr_t separator;
+         Node* right = split(node, separator);
+         if (hadParent) {
+            std::copy_backward(parent->inner.children + parentSlot + 1, parent->inner.children + parent->count, parent->inner.children + parent->count + 1);
+            std::copy_backward(parent->inner.separators + parentSlot, parent->inner.separators + parent->count - 1, parent->inner.separators + parent->count);
+            parent->inner.separators[parentSlot] = separator;
+            parent->inner.children[parentSlot + 1] = right;
+            ++parent->count;
+         } else {
+            parent = new Node(false);
+            parent->inner.separators[0] = separator;
+            parent->inner.children[0] = node;
+            parent->inner.children[1] = right;
+            parent->count = 2;
+            parentSlot = 0;
+            root.store(parent, std::memory_order_release);
+         }
+         node->lock.unlockExclusive();
+         if (hadParent) parent->lock.unlockExclusive();
+
+         // Continue in the half that receives the entry
+         if (entry.begin >= separator) {
+            node = right;
+            ++parentSlot;
+         } else if (entry.end > separator) {
+            parent->lock.lockExclusive();
+            parent->inner.separators[parentSlot] = entry.end;
+            parent->lock.unlockExclusive();
+         }
+      }
+      if (node->leaf) break;
+
+      // Route by the begin of the range. If the range crosses the separator we can move the separator,
+      // as the ranges are disjoint nothing in the right neighbor can start before the end
+      unsigned slot = 0;
+      while ((slot + 1 < node->count) && (entry.begin >= node->inner.separators[slot])) ++slot;
+      if ((slot + 1 < node->count) && (entry.end > node->inner.separators[slot])) {
+         node->lock.lockExclusive();
+         node->inner.separators[slot] = entry.end;
+         node->lock.unlockExclusive();
+      }
+      parent = node;
+      parentSlot = slot;
+      node = node->inner.children[slot];
+   }
+
+   // Insert into the leaf
+   node->lock.lockExclusive();
+   unsigned pos = 0;
+   while ((pos < node->count) && (node->entries[pos].begin < entry.begin)) ++pos;
+   std::copy_backward(node->entries + pos, node->entries + node->count, node->entries + node->count + 1);
+   node->entries[pos] = entry;
+   ++node->count;
+   node->lock.unlockExclusive();
+}
+
+void Btree::remove(uintptr_t begin) {
+   Node* node = root.load(std::memory_order_relaxed);
+   if (!node) return;
+   while (!node->leaf) {
+      unsigned slot = 0;
+      while ((slot + 1 < node->count) && (begin >= node->inner.separators[slot])) ++slot;
+      node = node->inner.children[slot];
+   }
+
+   // We do not merge underfull nodes, the separators stay valid when entries disappear
+   for (unsigned pos = 0; pos != node->count; ++pos)
+      if (node->entries[pos].begin == begin) {
+         node->lock.lockExclusive();
+         std::copy(node->entries + pos + 1, node->entries + node->count, node->entries + pos);
+         --node->count;
+         node->lock.unlockExclusive();
+         break;
+      }
+}
+
+/// The tree itself
+static Btree tree;
+/// Are lookups served from the tree?
+static std::atomic<bool> enabled{false};
+/// Serializes all modifications of the tree
+static std::mutex registryMutex;
+/// The ranges currently stored in the tree, sorted by begin. Protected by registryMutex
+static std::vector<Entry> registeredRanges;
+
+/// Is the per-thread lookup cache enabled?
+static std::atomic<bool> cacheEnabled{false};
+/// Changes whenever objects are opened or closed, which invalidates all cached lookups
+static std::atomic<unsigned> generation{1};
+
+/// A cached lookup result
+struct CacheEntry {
+   uintptr_t pc;
+   unsigned generation;
+   const void* fde;
+   dwarf_eh_bases bases;
+};
+/// The number of cache entries per thread
+constexpr unsigned cacheSize = 256;
+/// The direct-mapped per-thread cache
+static thread_local CacheEntry cache[cacheSize];
+
+/// Collect the executable ranges of a loaded object
+static int collectRanges(dl_phdr_info* info, size_t, void* data) {
+   auto& ranges = *static_cast<std::vector<Entry>*>(data);
+   const unsigned char* ehFrameHdr = nullptr;
+   for (unsigned index = 0; index != info->dlpi_phnum; ++index)
+      if (info->dlpi_phdr[index].p_type == PT_GNU_EH_FRAME)
+         ehFrameHdr = reinterpret_cast<const unsigned char*>(info->dlpi_addr + info->dlpi_phdr[index].p_vaddr);
+   if (!ehFrameHdr) return 0;
+
+   for (unsigned index = 0; index != info->dlpi_phnum; ++index) {
+      auto& phdr = info->dlpi_phdr[index];
+      if ((phdr.p_type == PT_LOAD) && (phdr.p_flags & PF_X))
+         ranges.push_back({info->dlpi_addr + phdr.p_vaddr, info->dlpi_addr + phdr.p_vaddr + phdr.p_memsz, ehFrameHdr});
+   }
+   return 0;
+}
+
+/// Bring the tree in sync with the currently loaded objects
+static void synchronize() {
+   std::vector<Entry> current;
+   dl_iterate_phdr(collectRanges, &current);
+   auto less = [](const Entry& a, const Entry& b) { return (a.begin < b.begin) || ((a.begin == b.begin) && ((a.end < b.end) || ((a.end == b.end) && (a.ehFrameHdr < b.ehFrameHdr)))); };
+   std::sort(current.begin(), current.end(), less);
+
+   // Remove vanished ranges first, a new object might reuse the address space
+   std::vector<Entry> changes;
+   std::set_difference(registeredRanges.begin(), registeredRanges.end(), current.begin(), current.end(), std::back_inserter(changes), less);
+   for (auto& e : changes) tree.remove(e.begin);
+   changes.clear();
+   std::set_difference(current.begin(), current.end(), registeredRanges.begin(), registeredRanges.end(), std::back_inserter(changes), less);
+   for (auto& e : changes) tree.insert(e);
+   registeredRanges = std::move(current);
+}
+
+/// Pointer encodings as used in .eh_frame_hdr and .eh_frame
+constexpr unsigned char DW_EH_PE_absptr = 0x00, DW_EH_PE_uleb128 = 0x01, DW_EH_PE_udata2 = 0x02, DW_EH_PE_udata4 = 0x03, DW_EH_PE_udata8 = 0x04;
+constexpr unsigned char DW_EH_PE_sleb128 = 0x09, DW_EH_PE_sdata2 = 0x0a, DW_EH_PE_sdata4 = 0x0b, DW_EH_PE_sdata8 = 0x0c;
+constexpr unsigned char DW_EH_PE_pcrel = 0x10, DW_EH_PE_datarel = 0x30, DW_EH_PE_aligned = 0x50, DW_EH_PE_indirect = 0x80, DW_EH_PE_omit = 0xff;
+
+/// Read a value of a given type from unaligned memory
+template <class T>
+static T readRaw(const unsigned char*& p) {
+   T result;
+   memcpy(&result, p, sizeof(T));
+   p += sizeof(T);
+   return result;
+}
+
+/// Read an unsigned LEB128 value
+static uintptr_t readULEB(const unsigned char*& p) {
+   uintptr_t result = 0;
+   unsigned shift = 0;
+   unsigned char byte;
+   do {
+      byte = *(p++);
+      result |= static_cast<uintptr_t>(byte & 0x7f) << shift;
+      shift += 7;
+   } while (byte & 0x80);
+   return result;
+}
+
+/// Read a signed LEB128 value
+static intptr_t readSLEB(const unsigned char*& p) {
+   uintptr_t result = 0;
+   unsigned shift = 0;
+   unsigned char byte;
+   do {
+      byte = *(p++);
+      result |= static_cast<uintptr_t>(byte & 0x7f) << shift;
+      shift += 7;
+   } while (byte & 0x80);
+   if ((shift < 8 * sizeof(result)) && (byte & 0x40)) result |= ~static_cast<uintptr_t>(0) << shift;
+   return static_cast<intptr_t>(result);
+}
+
+/// Read an encoded pointer
+static bool readEncoded(const unsigned char*& p, unsigned char encoding, uintptr_t dataBase, uintptr_t& result) {
+   if (encoding == DW_EH_PE_omit) {
+      result = 0;
+      return true;
+   }
+   if (encoding == DW_EH_PE_aligned) {
+      p = reinterpret_cast<const unsigned char*>((reinterpret_cast<uintptr_t>(p) + sizeof(void*) - 1) & ~(sizeof(void*) - 1));
+      result = readRaw<uintptr_t>(p);
+      return true;
+   }
+
+   uintptr_t pcBase = reinterpret_cast<uintptr_t>(p);
+   switch (encoding & 0x0f) {
+      case DW_EH_PE_absptr: result = readRaw<uintptr_t>(p); break;
+      case DW_EH_PE_uleb128: result = readULEB(p); break;
+      case DW_EH_PE_udata2: result = readRaw<uint16_t>(p); break;
+      case DW_EH_PE_udata4: result = readRaw<uint32_t>(p); break;
+      case DW_EH_PE_udata8: result = readRaw<uint64_t>(p); break;
+      case DW_EH_PE_sleb128: result = readSLEB(p); break;
+      case DW_EH_PE_sdata2: result = readRaw<int16_t>(p); break;
+      case DW_EH_PE_sdata4: result = readRaw<int32_t>(p); break;
+      case DW_EH_PE_sdata8: result = readRaw<int64_t>(p); break;
+      default: return false;
+   }
+   if (result) {
+      switch (encoding & 0x70) {
+         case DW_EH_PE_absptr: break;
+         case DW_EH_PE_pcrel: result += pcBase; break;
+         case DW_EH_PE_datarel: result += dataBase; break;
+         default: return false;
+      }
+      if (encoding & DW_EH_PE_indirect) result = *reinterpret_cast<const uintptr_t*>(result);
+   }
+   return true;
+}
+
+/// Determine the pointer encoding of an FDE by inspecting its CIE
+static bool getFDEEncoding(const unsigned char* fde, unsigned char& encoding) {
+   // The CIE pointer is relative to its own position. Read it first, readRaw advances the position
+   const unsigned char* cieOffset = fde + 4;
+   int32_t delta = readRaw<int32_t>(cieOffset);
+   const unsigned char* cie = fde + 4 - delta;
+   const unsigned char* p = cie;
+   if (readRaw<uint32_t>(p) == 0xffffffff) return false;
+   p += 4;
+   unsigned char version = *(p++);
+   const char* augmentation = reinterpret_cast<const char*>(p);
+   p += strlen(augmentation) + 1;
+   if ((augmentation[0] == 'e') && (augmentation[1] == 'h')) return false;
+   if (version >= 4) p += 2;
+   readULEB(p);
+   readSLEB(p);
+   if (version == 1)
+      ++p;
+   else
+      readULEB(p);
+
+   encoding = DW_EH_PE_absptr;
+   if (augmentation[0] != 'z') return true;
+   readULEB(p);
+   for (const char* a = augmentation + 1; *a; ++a) {
+      switch (*a) {
+         case 'R': encoding = *p; return true;
+         case 'P': {
+            unsigned char personalityEncoding = *(p++);
+            uintptr_t personality;
+            if (!readEncoded(p, personalityEncoding & ~DW_EH_PE_indirect, 0, personality)) return false;
+            break;
+         }
+         case 'L': ++p; break;
+         case 'S':
+         case 'B': break;
+         default: return false;
+      }
+   }
+   return true;
+}
+
+/// Find the FDE for pc using the binary search table in .eh_frame_hdr
+static const void* searchEhFrameHdr(const unsigned char* hdr, uintptr_t pc, dwarf_eh_bases* bases) {
+   if (hdr[0] != 1) return nullptr;
+   const unsigned char* p = hdr + 4;
+   uintptr_t dataBase = reinterpret_cast<uintptr_t>(hdr), ehFrame, fdeCount;
+   if (!readEncoded(p, hdr[1], dataBase, ehFrame) || !readEncoded(p, hdr[2], dataBase, fdeCount)) return nullptr;
+   if ((hdr[3] != (DW_EH_PE_datarel | DW_EH_PE_sdata4)) || (!fdeCount)) return nullptr;
+
+   // Find the last table entry that starts at or before pc
+   struct TableEntry {
+      int32_t initialLocation, fde;
+   };
+   auto table = reinterpret_cast<const TableEntry*>(p);
+   intptr_t target = pc - dataBase;
+   auto iter = std::upper_bound(table, table + fdeCount, target, [](intptr_t t, const TableEntry& e) { return t < e.initialLocation; });
+   if (iter == table) return nullptr;
+   --iter;
+
+   // Check that the FDE really covers pc
+   const unsigned char* fde = hdr + iter->fde;
+   unsigned char encoding;
+   if (!getFDEEncoding(fde, encoding)) return nullptr;
+   const unsigned char* q = fde + 8;
+   uintptr_t pcBegin, pcRange;
+   if (!readEncoded(q, encoding, 0, pcBegin) || !readEncoded(q, encoding & 0x0f, 0, pcRange)) return nullptr;
+   if (pc - pcBegin >= pcRange) return nullptr;
+
+   bases->tbase = nullptr;
+   bases->dbase = nullptr;
+   bases->func = reinterpret_cast<void*>(pcBegin);
+   return fde;
+}
+
+/// Find the FDE without consulting the cache. Falls back to the original for everything we cannot handle,
+/// for example frames registered with __register_frame_info
+static const void* lookupFDE(void* pc, dwarf_eh_bases* bases) {
+   if (enabled.load(std::memory_order_acquire)) {
+      Entry entry{};
+      if (tree.lookup(reinterpret_cast<uintptr_t>(pc), entry))
+         if (auto fde = searchEhFrameHdr(entry.ehFrameHdr, reinterpret_cast<uintptr_t>(pc), bases)) return fde;
+   }
+   return originalFindFDE()(pc, bases);
+}
+
+/// Find the FDE, consulting the per-thread cache first
+static const void* cachedLookupFDE(void* pc, dwarf_eh_bases* bases) {
+   uintptr_t key = reinterpret_cast<uintptr_t>(pc);
+   auto& slot = cache[(key ^ (key >> 8)) % cacheSize];
+   unsigned currentGeneration = generation.load(std::memory_order_acquire);
+   if ((slot.pc == key) && (slot.generation == currentGeneration)) {
+      *bases = slot.bases;
+      return slot.fde;
+   }
+   auto fde = lookupFDE(pc, bases);
+   if (fde) slot = {key, currentGeneration, fde, *bases};
+   return fde;
+}
+
+/// Forward to the original lookup. Only used until the constructor below resolved the original
+static const void* forwardFDELookup(void* pc, dwarf_eh_bases* bases) { return originalFindFDE()(pc, bases); }
+
+/// The lookup called by _Unwind_Find_FDE
+static std::atomic<FindFDEFunction> activeLookup{&forwardFDELookup};
+
+/// Resolve the original lookup early, so that the default path calls it directly
+static void __attribute__((constructor(101))) resolveOriginalFindFDE() {
+   if (auto original = originalFindFDE()) activeLookup.store(original, std::memory_order_relaxed);
+}
+
+}
+
+/// The current generation of loaded objects, changes with every dlopen and dlclose
+unsigned loadedObjectsGeneration() noexcept { return generation.load(std::memory_order_acquire); }
+
+extern "C" {
+
+/// Replaces the lookup function of the unwinder. Until the lock-free lookup or the cache is enabled, this is a
+/// tail call to the original
+const void* _Unwind_Find_FDE(void* pc, dwarf_eh_bases* bases) {
+   return activeLookup.load(std::memory_order_relaxed)(pc, bases);
+}
+
+/// Enable the lock-free lookup. Same hook name as the patched libgcc
+int __libunwind_btreelookup_sync() {
+   std::unique_lock lock(registryMutex);
+   synchronize();
+   enabled.store(true, std::memory_order_release);
+   if (!cacheEnabled.load(std::memory_order_relaxed)) activeLookup.store(&lookupFDE, std::memory_order_release);
+   return 0;
+}
+
+/// Enable the per-thread lookup cache
+int __libunwind_fdecache_enable() {
+   cacheEnabled.store(true, std::memory_order_release);
+   activeLookup.store(&cachedLookupFDE, std::memory_order_release);
+   return 0;
+}
+
+/// Intercept dlopen to register new objects
+void* dlopen(const char* file, int mode) noexcept {
+   static auto original = reinterpret_cast<void* (*)(const char*, int)>(dlsym(RTLD_NEXT, "dlopen"));
+   void* result = original(file, mode);
+   generation.fetch_add(1, std::memory_order_release);
+   if (result && enabled.load(std::memory_order_relaxed)) {
+      std::unique_lock lock(registryMutex);
+      synchronize();
+   }
+   return result;
+}
+
+/// Intercept dlclose to unregister vanished objects
+int dlclose(void* handle) noexcept {
+   static auto original = reinterpret_cast<int (*)(void*)>(dlsym(RTLD_NEXT, "dlclose"));
+   int result = original(handle);
+   generation.fetch_add(1, std::memory_order_release);
+   if (enabled.load(std::memory_order_relaxed)) {
+      std::unique_lock lock(registryMutex);
+      synchronize();
+   }
+   return result;
+}
+}
+
+#ifdef LOCKFREE_PRELOAD
+// When preloaded as a shared library we enable the lookup right away
+static void __attribute__((constructor)) enableLockfreeLookup() { __libunwind_btreelookup_sync(); }
+#endif
+
+#endif
@@ -1,34 +1,236 @@
 #include "thirdparty/tbv/tbv.hpp"
+#include "buildvariant.hpp"
+#include "simdsqrt.hpp"
+#include "sizedvalue.hpp"
+#include <algorithm>
+#include <cerrno>
 #include <cmath>
+#include <cstdlib>
 #include <span>
 
 struct InvalidValue {};
 
+/// Produce an error, either with a std::error_category or as an error of an integer domain
+template <bool domainErrors>
+static tbv::detail::errorresult raise() noexcept {
+   if constexpr (domainErrors)
+      return tbv::throw_value(tbv::generic_domain, EDOM);
+   else
+      return tbv::throw_value(std::make_error_code(std::errc::argument_out_of_domain));
+}
+
+template <bool domainErrors>
 static tbv::result<void> doSqrt(std::span<double> values) noexcept __attribute__((noinline));
+template <bool domainErrors>
 static tbv::result<void> doSqrt(std::span<double> values) noexcept {
    for (auto& v : values) {
-      if (v < 0) return tbv::throw_value(std::make_error_code(std::errc::argument_out_of_domain));
+      if (v < 0) return raise<domainErrors>();
       v = sqrt(v);
    }
    return {};
 }
 
-unsigned herbceptionEmulationSqrt(std::span<double> values, unsigned repeat) noexcept {
+template <bool domainErrors>
+static unsigned sqrtImpl(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      if (doSqrt<domainErrors>(values).has_error()) ++failures;
+   }
+   return failures;
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationSqrt)(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<false>(values, repeat); }
+unsigned VARIANT_NAME(herbceptionEmulationDomainSqrt)(std::span<double> values, unsigned repeat) noexcept { return sqrtImpl<true>(values, repeat); }
+
+// The same with a vectorized kernel, which raises the error once for all values
+static tbv::result<void> doSimdSqrt(std::span<double> values) noexcept __attribute__((noinline));
+static tbv::result<void> doSimdSqrt(std::span<double> values) noexcept {
+   if (!simdSqrt(values)) return raise<false>();
+   return {};
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationSimdSqrt)(std::span<double> values, unsigned repeat) noexcept {
    unsigned failures = 0;
    for (unsigned index = 0; index != repeat; ++index) {
-      if (doSqrt(values).has_error()) ++failures;
+      if (doSimdSqrt(values).has_error()) ++failures;
    }
    return failures;
 }
 
+// Processing the values as a batch. A failure reports its position, and the caller resumes after the failing value
+static tbv::batch_result doBatchSqrt(std::span<double> values) noexcept __attribute__((noinline));
+static tbv::batch_result doBatchSqrt(std::span<double> values) noexcept {
+   for (size_t index = 0; index != values.size(); ++index) {
+      auto& v = values[index];
+      if (v < 0) return {static_cast<uint32_t>(index), raise<false>()};
+      v = sqrt(v);
+   }
+   return values.size();
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationBatchSqrt)(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      for (auto rest = values; !rest.empty();) {
+         auto r = doBatchSqrt(rest.first(std::min<size_t>(rest.size(), tbv::max_batch_size)));
+         if (r.has_error()) ++failures;
+         rest = rest.subspan(r.processed() + r.has_error());
+      }
+   }
+   return failures;
+}
+
+template <bool domainErrors>
 static tbv::result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <bool domainErrors>
 static tbv::result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept {
-   if (!maxDepth) return tbv::throw_value(std::make_error_code(std::errc::argument_out_of_domain));
+   if (!maxDepth) return raise<domainErrors>();
    if (n <= 2) return 1;
-   return TRY(doFib(n - 2, maxDepth - 1)) + TRY(doFib(n - 1, maxDepth - 1));
+   return TRY(doFib<domainErrors>(n - 2, maxDepth - 1)) + TRY(doFib<domainErrors>(n - 1, maxDepth - 1));
 }
 
-unsigned herbceptionEmulationFib(unsigned n, unsigned maxDepth) noexcept {
-   auto v = doFib(n, maxDepth);
+unsigned VARIANT_NAME(herbceptionEmulationFib)(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doFib<false>(n, maxDepth);
    return v.has_error() ? 0 : v.value();
 }
+
+unsigned VARIANT_NAME(herbceptionEmulationDomainFib)(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doFib<true>(n, maxDepth);
+   return v.has_error() ? 0 : v.value();
+}
+
+// The same computation, but chaining the calls with and_then and transform instead of TRY. make check-monadic compares
+// the calls and branches of both functions. GCC 12 emits one more instruction here, a register copy of the first
+// result because the sum is built in a different register than the error return. It is a move between registers
+// that the renamer eliminates on current x86 cores
+static tbv::result<unsigned> doMonadicFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+static tbv::result<unsigned> doMonadicFib(unsigned n, unsigned maxDepth) noexcept {
+   if (!maxDepth) return raise<false>();
+   if (n <= 2) return 1;
+   return doMonadicFib(n - 2, maxDepth - 1).and_then([=](unsigned n2) { return doMonadicFib(n - 1, maxDepth - 1).transform([=](unsigned n1) { return n2 + n1; }); });
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationMonadicFib)(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doMonadicFib(n, maxDepth);
+   return v.has_error() ? 0 : v.value();
+}
+
+// The same computation, but returning an owning handle instead of a plain value. This measures results of
+// types with non-trivial destructors. The values live in a per-thread pool of slots
+namespace {
+
+/// A pool slot
+union HandleSlot {
+   unsigned value;
+   HandleSlot* next;
+};
+
+/// The slots of a thread
+struct HandleSlots {
+   /// The number of slots, enough for the recursion depth used in the benchmark
+   static constexpr unsigned slotCount = 256;
+   /// The slots
+   HandleSlot slots[slotCount];
+   /// The number of slots that were ever used
+   unsigned used = 0;
+   /// The free slots
+   HandleSlot* freeList = nullptr;
+
+   /// Get a slot
+   HandleSlot* acquire() noexcept {
+      auto slot = freeList;
+      if (slot) {
+         freeList = slot->next;
+         return slot;
+      }
+      if (used == slotCount) abort();
+      return &slots[used++];
+   }
+   /// Release a slot
+   void release(HandleSlot* slot) noexcept {
+      slot->next = freeList;
+      freeList = slot;
+   }
+};
+static thread_local HandleSlots handleSlots;
+
+/// An owning handle to a value. The relocatable version is marked as trivially relocatable
+template <bool relocatable>
+class FibHandle {
+   /// The slot, nullptr if moved away
+   HandleSlot* slot;
+
+   public:
+   /// Constructor
+   explicit FibHandle(unsigned v) noexcept : slot(handleSlots.acquire()) { slot->value = v; }
+   /// Move constructor
+   FibHandle(FibHandle&& o) noexcept : slot(o.slot) { o.slot = nullptr; }
+   /// Destructor
+   ~FibHandle() {
+      if (slot) handleSlots.release(slot);
+   }
+
+   /// Get the value
+   unsigned get() const noexcept { return slot->value; }
+};
+
+}
+
+template <>
+struct tbv::is_trivially_relocatable<FibHandle<true>> : std::true_type {};
+
+template <bool relocatable>
+static tbv::result<FibHandle<relocatable>> doHandleFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <bool relocatable>
+static tbv::result<FibHandle<relocatable>> doHandleFib(unsigned n, unsigned maxDepth) noexcept {
+   if (!maxDepth) return tbv::throw_value(std::make_error_code(std::errc::argument_out_of_domain));
+   if (n <= 2) return FibHandle<relocatable>(1);
+   auto n2 = TRY(doHandleFib<relocatable>(n - 2, maxDepth - 1));
+   auto n1 = TRY(doHandleFib<relocatable>(n - 1, maxDepth - 1));
+   return FibHandle<relocatable>(n2.get() + n1.get());
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationHandleFib)(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doHandleFib<false>(n, maxDepth);
+   return v.has_error() ? 0 : v.value().get();
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationRelocatableHandleFib)(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doHandleFib<true>(n, maxDepth);
+   return v.has_error() ? 0 : v.value().get();
+}
+
+// The fib computation with results of different sizes. The niche variant marks errors with an impossible value,
+// which keeps the result as small as the value itself
+template <unsigned size>
+struct NicheValue : SizedValue<size> {};
+
+template <unsigned size>
+struct tbv::niche_traits<NicheValue<size>> {
+   static constexpr bool available = true;
+   static NicheValue<size> error() noexcept { return makeSizedValue<NicheValue<size>>(~0u); }
+   static bool is_error(const NicheValue<size>& v) noexcept { return v.value == ~0u; }
+};
+
+template <class T>
+static tbv::result<T> doSizedFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <class T>
+static tbv::result<T> doSizedFib(unsigned n, unsigned maxDepth) noexcept {
+   if (!maxDepth) return tbv::throw_value(std::make_error_code(std::errc::argument_out_of_domain));
+   if (n <= 2) return makeSizedValue<T>(1);
+   return makeSizedValue<T>(TRY(doSizedFib<T>(n - 2, maxDepth - 1)).value + TRY(doSizedFib<T>(n - 1, maxDepth - 1)).value);
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationSizedFib)(unsigned size, unsigned n, unsigned maxDepth) noexcept {
+   return dispatchResultSize(size, [&]<unsigned s>() -> unsigned {
+      auto v = doSizedFib<SizedValue<s>>(n, maxDepth);
+      return v.has_error() ? 0 : v.value().value;
+   });
+}
+
+unsigned VARIANT_NAME(herbceptionEmulationNicheSizedFib)(unsigned size, unsigned n, unsigned maxDepth) noexcept {
+   return dispatchResultSize(size, [&]<unsigned s>() -> unsigned {
+      auto v = doSizedFib<NicheValue<s>>(n, maxDepth);
+      return v.has_error() ? 0 : v.value().value;
+   });
+}
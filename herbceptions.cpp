@@ -1,16 +1,80 @@
 #include "thirdparty/tbv/tbv.hpp"
+#include <cerrno>
 #include <cmath>
 #include <span>
 
 unsigned herbceptionEmulationSqrt(std::span<double> values, unsigned repeat) noexcept;
 unsigned herbceptionEmulationFib(unsigned n, unsigned maxDepth) noexcept;
 
-unsigned herbceptionsSqrt(std::span<double> values, unsigned repeat) noexcept {
-   // The emulation is good enough here, the call overhead is negligible
-   return herbceptionEmulationSqrt(values, repeat);
+#if defined(__x86_64__) && defined(__linux__)
+
+#define STRINGIFY2(x) #x
+#define STRINGIFY(x) STRINGIFY2(x)
+
+// The error is returned as std::error_code in rax:rdx, i.e., the value and the tagged category pointer
+static unsigned doSqrt(double* values, unsigned long count, unsigned repeat, uintptr_t category) __attribute__((naked));
+static unsigned doSqrt(double* /*values*/, unsigned long /*count*/, unsigned /*repeat*/, uintptr_t /*category*/) {
+   asm(R"(
+        pushq   %rbx
+        pushq   %r12
+        pushq   %r13
+        pushq   %r14
+        pushq   %r15
+        movq    %rdi, %r12
+        movq    %rsi, %r13
+        movl    %edx, %ebx
+        movq    %rcx, %r15
+        xorl    %r14d, %r14d
+        testl   %ebx, %ebx
+        je      .LBsqrt_done
+.LBsqrt_loop:
+        movq    %r12, %rdi
+        movq    %r13, %rsi
+        movq    %r15, %rcx
+        callq   .LBsqrt
+        jc      .LBsqrt_failed
+.LBsqrt_next:
+        decl    %ebx
+        jne     .LBsqrt_loop
+.LBsqrt_done:
+        movl    %r14d, %eax
+        popq    %r15
+        popq    %r14
+        popq    %r13
+        popq    %r12
+        popq    %rbx
+        retq
+.LBsqrt_failed:
+        incl    %r14d
+        jmp     .LBsqrt_next
+
+.LBsqrt:
+        xorpd   %xmm1, %xmm1
+        testq   %rsi, %rsi
+        je      .LBsqrt_ok
+.LBsqrt_value:
+        movsd   (%rdi), %xmm0
+        ucomisd %xmm0, %xmm1
+        ja      .LBsqrt_error
+        sqrtsd  %xmm0, %xmm0
+        movsd   %xmm0, (%rdi)
+        addq    $8, %rdi
+        decq    %rsi
+        jne     .LBsqrt_value
+.LBsqrt_ok:
+        clc
+        retq
+.LBsqrt_error:
+        movl    $)" STRINGIFY(EDOM) R"(, %eax
+        movq    %rcx, %rdx
+        stc
+        retq
+   )");
 }
 
-#if defined(__x86_64__) && defined(__linux__)
+unsigned herbceptionsSqrt(std::span<double> values, unsigned repeat) noexcept {
+   return doSqrt(values.data(), values.size(), repeat, tbv::detail::tagErrorPointer(std::generic_category()));
+}
 
 static unsigned doFib(unsigned n, unsigned maxDepth) __attribute__((naked));
 static unsigned doFib(unsigned /*n*/, unsigned /*maxDepth*/) {
@@ -59,5 +123,7 @@ unsigned herbceptionsFib(unsigned n, unsigned maxDepth) noexcept {
 #else
 #warning No herbception implementation provided for this platform, falling back to emulation
 
+unsigned herbceptionsSqrt(std::span<double> values, unsigned repeat) noexcept { return herbceptionEmulationSqrt(values, repeat); }
+
 unsigned herbceptionsFib(unsigned n, unsigned maxDepth) { return herbceptionEmulationFib(n, maxDepth); }
 #endif
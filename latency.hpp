@@ -0,0 +1,152 @@
+#ifndef H_latency
+#define H_latency
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Per-call latencies. The total runtime of a run hides rare slow calls, so in latency mode every call is timed with
+// the time stamp counter and recorded into log-bucketed histograms, one for calls that succeeded and one for calls
+// that failed.
+
+/// Read the time stamp counter. The fences keep the measured call from moving across the read
+static inline uint64_t readTsc() {
+#if defined(__x86_64__) || defined(__i386__)
+   _mm_lfence();
+   uint64_t result = __rdtsc();
+   _mm_lfence();
+   return result;
+#elif defined(__aarch64__)
+   uint64_t result;
+   asm volatile("isb; mrs %0, cntvct_el0" : "=r"(result)::"memory");
+   return result;
+#else
+#warning no cycle counter on this platform, falling back to steady_clock
+   return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/// The calibration of the time stamp counter
+struct TscCalibration {
+   /// The nanoseconds per tick
+   double nsPerTick;
+   /// The ticks measured for an empty interval
+   uint64_t overhead;
+
+   /// Calibrate once
+   static const TscCalibration& get() {
+      static const TscCalibration calibration = compute();
+      return calibration;
+   }
+
+   private:
+   static TscCalibration compute() {
+      TscCalibration result;
+
+      // The overhead is the smallest difference between two back-to-back reads
+      result.overhead = ~uint64_t(0);
+      for (unsigned index = 0; index != 10000; ++index) {
+         uint64_t start = readTsc(), stop = readTsc();
+         result.overhead = std::min(result.overhead, stop - start);
+      }
+
+      // Compare the ticks with the steady clock over 10ms
+      auto clockStart = std::chrono::steady_clock::now();
+      uint64_t tscStart = readTsc();
+      while (std::chrono::steady_clock::now() - clockStart < std::chrono::milliseconds(10)) {}
+      auto clockStop = std::chrono::steady_clock::now();
+      uint64_t tscStop = readTsc();
+      result.nsPerTick = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(clockStop - clockStart).count()) / static_cast<double>(tscStop - tscStart);
+      return result;
+   }
+};
+
+/// A histogram with logarithmic buckets, each divided into linear sub-buckets like HdrHistogram.
+/// Values below 2^subBits are recorded exactly, larger values with a relative error below 2^-subBits
+class LatencyHistogram {
+   /// The number of bits resolved within a power of two
+   static constexpr unsigned subBits = 5;
+   /// The number of sub-buckets per power of two
+   static constexpr unsigned subCount = 1u << subBits;
+   /// The number of buckets
+   static constexpr unsigned bucketCount = (64 - subBits + 1) * subCount;
+
+   /// The counts
+   uint64_t counts[bucketCount] = {};
+   /// The number of values
+   uint64_t total = 0;
+   /// The largest value
+   uint64_t maxValue = 0;
+
+   /// The bucket of a value
+   static unsigned bucketOf(uint64_t v) {
+      if (v < subCount) return v;
+      unsigned e = 63 - __builtin_clzll(v);
+      return (e - subBits + 1) * subCount + ((v >> (e - subBits)) - subCount);
+   }
+   /// The largest value within a bucket
+   static uint64_t highestIn(unsigned bucket) {
+      if (bucket < subCount) return bucket;
+      unsigned shift = bucket / subCount - 1;
+      uint64_t low = static_cast<uint64_t>(bucket % subCount + subCount) << shift;
+      return low + ((uint64_t(1) << shift) - 1);
+   }
+
+   public:
+   /// Record a value
+   void record(uint64_t v) {
+      ++counts[bucketOf(v)];
+      ++total;
+      maxValue = std::max(maxValue, v);
+   }
+   /// Add the values of another histogram
+   void merge(const LatencyHistogram& other) {
+      for (unsigned index = 0; index != bucketCount; ++index) counts[index] += other.counts[index];
+      total += other.total;
+      maxValue = std::max(maxValue, other.maxValue);
+   }
+
+   /// The number of values
+   uint64_t count() const { return total; }
+   /// The largest value
+   uint64_t max() const { return maxValue; }
+   /// The value below which the given fraction of the values fall, up to the resolution of the buckets
+   uint64_t percentile(double fraction) const {
+      uint64_t target = std::max<uint64_t>(static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.999999), 1), seen = 0;
+      for (unsigned index = 0; index != bucketCount; ++index)
+         if ((seen += counts[index]) >= target) return std::min(highestIn(index), maxValue);
+      return maxValue;
+   }
+};
+
+/// Does not measure anything, used when only the total runtime is of interest
+struct NoLatency {
+   /// Call the function
+   template <class F, class P>
+   auto measure(F&& call, P&&) { return call(); }
+};
+
+/// Measures every call and records it as success or failure
+struct alignas(64) LatencyRecorder {
+   /// The latencies of calls that succeeded, in ticks
+   LatencyHistogram success;
+   /// The latencies of calls that failed, in ticks
+   LatencyHistogram failure;
+
+   /// Call the function and record its latency. errors computes the number of errors from the result
+   template <class F, class P>
+   auto measure(F&& call, P&& errors) {
+      uint64_t overhead = TscCalibration::get().overhead;
+      uint64_t start = readTsc();
+      auto result = call();
+      uint64_t stop = readTsc();
+      uint64_t ticks = stop - start;
+      (errors(result) ? failure : success).record(ticks > overhead ? ticks - overhead : 0);
+      return result;
+   }
+};
+
+#endif
@@ -1,4 +1,7 @@
 #include "thirdparty/leaf/leaf.hpp"
+#include "buildvariant.hpp"
+#include "simdsqrt.hpp"
+#include "sizedvalue.hpp"
 #include <cmath>
 #include <span>
 
@@ -15,7 +18,7 @@ static leaf::result<void> doSqrt(std::span<double> values) noexcept {
    return {};
 }
 
-unsigned leafResultSqrt(std::span<double> values, unsigned repeat) noexcept {
+unsigned VARIANT_NAME(leafResultSqrt)(std::span<double> values, unsigned repeat) noexcept {
    unsigned failures = 0;
    for (unsigned index = 0; index != repeat; ++index) {
       leaf::try_handle_some([&]() -> leaf::result<void> {
@@ -28,6 +31,26 @@ unsigned leafResultSqrt(std::span<double> values, unsigned repeat) noexcept {
    return failures;
 }
 
+// The same with a vectorized kernel, which raises the error once for all values
+static leaf::result<void> doSimdSqrt(std::span<double> values) noexcept __attribute__((noinline));
+static leaf::result<void> doSimdSqrt(std::span<double> values) noexcept {
+   if (!simdSqrt(values)) return leaf::new_error(InvalidValue{});
+   return {};
+}
+
+unsigned VARIANT_NAME(leafResultSimdSqrt)(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      leaf::try_handle_some([&]() -> leaf::result<void> {
+         BOOST_LEAF_CHECK(doSimdSqrt(values));
+         return {}; },
+                            [&](InvalidValue) {
+                               ++failures;
+                            });
+   }
+   return failures;
+}
+
 static leaf::result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
 static leaf::result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept {
    if (!maxDepth) return leaf::new_error(InvalidValue{});
@@ -37,7 +60,7 @@ static leaf::result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept {
    return n2 + n1;
 }
 
-unsigned leafResultFib(unsigned n, unsigned maxDepth) noexcept {
+unsigned VARIANT_NAME(leafResultFib)(unsigned n, unsigned maxDepth) noexcept {
    unsigned result = ~0u;
    leaf::try_handle_some([&]() -> leaf::result<void> {
          BOOST_LEAF_AUTO(v, doFib(n, maxDepth));
@@ -48,3 +71,28 @@ unsigned leafResultFib(unsigned n, unsigned maxDepth) noexcept {
                          });
    return result;
 }
+
+template <unsigned size>
+static leaf::result<SizedValue<size>> doSizedFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <unsigned size>
+static leaf::result<SizedValue<size>> doSizedFib(unsigned n, unsigned maxDepth) noexcept {
+   if (!maxDepth) return leaf::new_error(InvalidValue{});
+   if (n <= 2) return makeSizedValue<SizedValue<size>>(1);
+   BOOST_LEAF_AUTO(n2, doSizedFib<size>(n - 2, maxDepth - 1));
+   BOOST_LEAF_AUTO(n1, doSizedFib<size>(n - 1, maxDepth - 1));
+   return makeSizedValue<SizedValue<size>>(n2.value + n1.value);
+}
+
+unsigned VARIANT_NAME(leafResultSizedFib)(unsigned size, unsigned n, unsigned maxDepth) noexcept {
+   return dispatchResultSize(size, [&]<unsigned s>() -> unsigned {
+      unsigned result = ~0u;
+      leaf::try_handle_some([&]() -> leaf::result<void> {
+         BOOST_LEAF_AUTO(v, doSizedFib<s>(n, maxDepth));
+         result = v.value;
+         return {}; },
+                            [&](InvalidValue) {
+                               result = 0;
+                            });
+      return result;
+   });
+}
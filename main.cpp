@@ -1,8 +1,17 @@
+#include "latency.hpp"
+#include "perfcounters.hpp"
+#include "statistics.hpp"
+#include "topology.hpp"
+#include "workerpool.hpp"
 #include <atomic>
 #include <charconv>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
 #include <iostream>
+#include <mutex>
 #include <span>
+#include <string>
 #include <thread>
 #include <vector>
 
@@ -12,19 +21,96 @@ unsigned baselineSqrt(span<double> values, unsigned repeat);
 unsigned baselineFib(unsigned n, unsigned maxDepth);
 unsigned exceptionsSqrt(span<double> values, unsigned repeat);
 unsigned exceptionsFib(unsigned n, unsigned maxDepth);
+unsigned exceptionsMemoizedSqrt(span<double> values, unsigned repeat);
+unsigned exceptionsMemoizedFib(unsigned n, unsigned maxDepth);
+unsigned exceptionsPooledSqrt(span<double> values, unsigned repeat);
+unsigned exceptionsPooledFib(unsigned n, unsigned maxDepth);
+unsigned sjljExceptionsSqrt(span<double> values, unsigned repeat);
+unsigned sjljExceptionsFib(unsigned n, unsigned maxDepth);
 unsigned leafResultSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned leafResultFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtIdBlocks(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibIdBlocks(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtCapture(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibCapture(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtExceptions(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibExceptions(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtDiagnostics(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibDiagnostics(unsigned n, unsigned maxDepth) noexcept;
 unsigned expectedSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned expectedFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned expectedBatchSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned stdExpectedSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned stdExpectedFib(unsigned n, unsigned maxDepth) noexcept;
 unsigned herbceptionEmulationSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned herbceptionEmulationFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationHandleFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationRelocatableHandleFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationDomainSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationDomainFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationMonadicFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationBatchSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationSqrtExceptions(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationFibExceptions(unsigned n, unsigned maxDepth) noexcept;
 unsigned herbceptionsSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned herbceptionsFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned altReturnSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned altReturnFib(unsigned n, unsigned maxDepth) noexcept;
 unsigned outcomeResultSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned outcomeResultFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned outcomeResultSqrtNarrow(span<double> values, unsigned repeat) noexcept;
+unsigned outcomeResultFibNarrow(unsigned n, unsigned maxDepth) noexcept;
+unsigned outcomeResultSqrtExceptions(span<double> values, unsigned repeat) noexcept;
+unsigned outcomeResultFibExceptions(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotAccessorSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotAccessorFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotInitialExecSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotInitialExecFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotGeneralDynamicSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotGeneralDynamicFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineArenaSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineArenaFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineRootJumpSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineRootJumpFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineArenaRootJumpSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineArenaRootJumpFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned classifyCategorySqrt(span<double> values, unsigned repeat) noexcept;
+unsigned classifyCategoryFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned classifyDomainSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned classifyDomainFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned poisonSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned poisonFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned baselineSimdSqrt(span<double> values, unsigned repeat);
+unsigned exceptionsSimdSqrt(span<double> values, unsigned repeat);
+unsigned leafResultSimdSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned expectedSimdSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationSimdSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned outcomeResultSimdSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned exceptionsSizedFib(unsigned size, unsigned n, unsigned maxDepth);
+unsigned leafResultSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSizedFibIdBlocks(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSizedFibCapture(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSizedFibExceptions(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSizedFibDiagnostics(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned expectedSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned stdExpectedSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationNicheSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationSizedFibExceptions(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned outcomeResultSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned outcomeResultSizedFibNarrow(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+unsigned outcomeResultSizedFibExceptions(unsigned size, unsigned n, unsigned maxDepth) noexcept;
 
 using TestedFunctionSqrt = unsigned (*)(span<double>, unsigned);
 using TestedFunctionFib = unsigned (*)(unsigned, unsigned);
+using TestedFunctionSizedFib = unsigned (*)(unsigned, unsigned, unsigned);
+
+// The number of calls to the tested function in one run
+static constexpr unsigned callsPerRun = 10000;
 
 // A weak but fast PRNG is good enough for this. Use xorshift.
 // We seed it with the thread id to get deterministic behavior
@@ -42,8 +128,9 @@ struct Random {
    }
 };
 
-// Perform one run with a certain error probability
-static unsigned doTest(TestedFunctionSqrt func, unsigned errorRate, unsigned seed) {
+// Perform one run with a certain error probability. Returns the runtime in microseconds
+template <class Recorder>
+static unsigned doTest(TestedFunctionSqrt func, unsigned errorRate, unsigned seed, Recorder& recorder) {
    Random random(seed);
 
    // Prepare an array of values
@@ -52,14 +139,14 @@ static unsigned doTest(TestedFunctionSqrt func, unsigned errorRate, unsigned see
 
    // Execute the function n times and measure the runtime
    auto start = std::chrono::steady_clock::now();
-   constexpr unsigned repeat = 10000, innerRepeat = 10;
+   constexpr unsigned repeat = callsPerRun, innerRepeat = 10;
    unsigned result = 0;
    for (unsigned index = 0; index != repeat; ++index) {
       // Cause a failure with a certain probability
       if ((random() % 1000) < errorRate) values[10] = -1;
 
       // Call the function itself
-      result += func(values, innerRepeat);
+      result += recorder.measure([&]() { return func(values, innerRepeat); }, [](unsigned failures) { return failures; });
 
       // Reset the invalid entry
       values[10] = 1;
@@ -68,16 +155,23 @@ static unsigned doTest(TestedFunctionSqrt func, unsigned errorRate, unsigned see
       cerr << "invalid result!" << endl;
    auto stop = std::chrono::steady_clock::now();
 
-   return std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+   return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
 };
 
 // Perform one run with a certain error probability
-static unsigned doTest(TestedFunctionFib func, unsigned errorRate, unsigned seed) {
+static unsigned doTest(TestedFunctionSqrt func, unsigned errorRate, unsigned seed) {
+   NoLatency recorder;
+   return doTest(func, errorRate, seed, recorder);
+}
+
+// Perform one run of the fib computation with a certain error probability. Returns the runtime in microseconds
+template <class F, class Recorder>
+static unsigned doFibTest(F func, unsigned errorRate, unsigned seed, Recorder& recorder) {
    Random random(seed);
 
    // Execute the function n times and measure the runtime
    auto start = std::chrono::steady_clock::now();
-   constexpr unsigned repeat = 10000;
+   constexpr unsigned repeat = callsPerRun;
    constexpr unsigned depth = 15, expected = 610;
    unsigned result = 0;
    for (unsigned index = 0; index != repeat; ++index) {
@@ -86,52 +180,263 @@ static unsigned doTest(TestedFunctionFib func, unsigned errorRate, unsigned seed
       if ((random() % 1000) < errorRate) maxDepth = depth - 2;
 
       // Call the function itself
-      result += (func(depth, maxDepth) == expected);
+      result += (recorder.measure([&]() { return func(depth, maxDepth); }, [](unsigned v) { return static_cast<unsigned>(v != expected); }) == expected);
    }
    if (!result)
       cerr << "invalid result!" << endl;
    auto stop = std::chrono::steady_clock::now();
 
-   return std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count();
+   return std::chrono::duration_cast<std::chrono::microseconds>(stop - start).count();
 };
 
-// Perform the test using n threads
-template <class T>
-static unsigned doTestMultithreaded(T func, unsigned errorRate, unsigned threadCount) {
-   if (threadCount <= 1) return func(errorRate, 0);
+// Perform one run with a certain error probability
+template <class Recorder>
+static unsigned doTest(TestedFunctionFib func, unsigned errorRate, unsigned seed, Recorder& recorder) {
+   return doFibTest(func, errorRate, seed, recorder);
+}
 
-   vector<thread> threads;
+// Perform one run with a certain error probability
+static unsigned doTest(TestedFunctionFib func, unsigned errorRate, unsigned seed) {
+   NoLatency recorder;
+   return doFibTest(func, errorRate, seed, recorder);
+}
+
+// Perform one run with a certain error probability and result size
+static unsigned doTest(TestedFunctionSizedFib func, unsigned size, unsigned errorRate, unsigned seed) {
+   NoLatency recorder;
+   return doFibTest([func, size](unsigned n, unsigned maxDepth) { return func(size, n, maxDepth); }, errorRate, seed, recorder);
+}
+
+// The result of a multithreaded run
+struct Measurement {
+   /// The longest duration of a thread in microseconds
+   unsigned maxDuration;
+   /// The calls of all threads per second, measured from the first start to the last end
+   double callsPerSecond;
+};
+
+// Round a duration in microseconds to the printed milliseconds
+static unsigned toMilliseconds(unsigned micros) { return (micros + 500) / 1000; }
+
+// Perform the test using n threads. The threads start together and run concurrently from the first call on
+template <class T>
+static Measurement doTestMultithreaded(T func, unsigned errorRate, unsigned threadCount) {
    atomic<unsigned> maxDuration{0};
-   threads.reserve(threadCount);
-   for (unsigned index = 0; index != threadCount; ++index) {
-      threads.push_back(thread([index, func, errorRate, &maxDuration]() {
-         unsigned duration = func(errorRate, index);
-         unsigned current = maxDuration.load();
-         while ((duration > current) && (!maxDuration.compare_exchange_weak(current, duration))) {}
-      }));
+   auto wallTime = WorkerPool::get().run(threadCount, [func, errorRate, &maxDuration](unsigned id) {
+      unsigned duration = func(errorRate, id);
+      unsigned current = maxDuration.load();
+      while ((duration > current) && (!maxDuration.compare_exchange_weak(current, duration))) {}
+   });
+   double seconds = std::chrono::duration<double>(wallTime).count();
+   return {maxDuration.load(), seconds > 0 ? static_cast<double>(threadCount) * callsPerRun / seconds : 0};
+}
+
+// Print the latency percentiles of one histogram
+static void printLatency(const char* name, const LatencyHistogram& h) {
+   cout << "  " << name << ": ";
+   if (!h.count()) {
+      cout << "no calls" << endl;
+      return;
+   }
+   double nsPerTick = TscCalibration::get().nsPerTick;
+   auto show = [nsPerTick](uint64_t ticks) {
+      char buffer[32];
+      snprintf(buffer, sizeof(buffer), "%.0f", static_cast<double>(ticks) * nsPerTick);
+      return string(buffer);
    };
-   for (auto& t : threads) t.join();
-   return maxDuration.load();
+   cout << h.count() << " calls, p50 " << show(h.percentile(0.5)) << " p90 " << show(h.percentile(0.9)) << " p99 " << show(h.percentile(0.99)) << " p99.9 " << show(h.percentile(0.999)) << " max " << show(h.max()) << " ns" << endl;
+}
+
+// Measure the latency of every call using n threads and print the percentiles. All repetitions go into the same histograms
+template <class T>
+static void doLatencyTest(T func, unsigned errorRate, unsigned threadCount, unsigned repetitions) {
+   vector<LatencyRecorder> recorders(max(threadCount, 1u));
+   for (unsigned index = 0; index != repetitions; ++index)
+      doTestMultithreaded([func, &recorders](unsigned errorRate, unsigned id) { return doTest(func, errorRate, id, recorders[id]); }, errorRate, threadCount);
+
+   LatencyRecorder merged;
+   for (auto& r : recorders) {
+      merged.success.merge(r.success);
+      merged.failure.merge(r.failure);
+   }
+   printLatency("success", merged.success);
+   printLatency("failure", merged.failure);
+}
+
+// Counts the calls and the errors
+struct CallCounter {
+   /// The calls
+   uint64_t calls = 0;
+   /// The errors
+   uint64_t errors = 0;
+
+   /// Call the function and count
+   template <class F, class P>
+   auto measure(F&& call, P&& errorCount) {
+      auto result = call();
+      ++calls;
+      errors += errorCount(result);
+      return result;
+   }
+};
+
+// Perform the test using n threads and count the hardware events of all threads
+template <class T>
+static Measurement doCounterTestMultithreaded(T func, unsigned errorRate, unsigned threadCount, PerfValues& values, CallCounter& calls) {
+   mutex m;
+   auto test = [func, &values, &calls, &m](unsigned errorRate, unsigned id) {
+      PerfCounters counters;
+      PerfValues threadValues;
+      CallCounter threadCalls;
+      counters.start();
+      unsigned duration = doTest(func, errorRate, id, threadCalls);
+      counters.stop(threadValues);
+
+      unique_lock lock(m);
+      values.merge(threadValues);
+      calls.calls += threadCalls.calls;
+      calls.errors += threadCalls.errors;
+      return duration;
+   };
+   return doTestMultithreaded(test, errorRate, threadCount);
+}
+
+// Print the counters per call, and the increase over the error-free run per error
+static void printCounters(unsigned threadCount, const PerfValues& values, const CallCounter& calls, const PerfValues& happyPath, const CallCounter& happyCalls) {
+   auto print = [&](auto&& value) {
+      for (unsigned index = 0; index != PerfEventCount; ++index) {
+         char buffer[32] = "n/a";
+         // Rare events like context switches need significant digits instead of decimals
+         if (values.available[index]) {
+            double v = value(index);
+            snprintf(buffer, sizeof(buffer), (std::abs(v) < 0.1) ? "%.2g" : "%.2f", v);
+         }
+         cout << (index ? ", " : " ") << buffer << " " << perfEventNames[index];
+      }
+   };
+   cout << "  " << threadCount << " threads:";
+   print([&](unsigned e) { return values.counts[e] / static_cast<double>(calls.calls); });
+   cout << " per call";
+   if (calls.errors && happyCalls.calls) {
+      cout << ";";
+      print([&](unsigned e) { return (values.counts[e] / static_cast<double>(calls.calls) - happyPath.counts[e] / static_cast<double>(happyCalls.calls)) * static_cast<double>(calls.calls) / static_cast<double>(calls.errors); });
+      cout << " per error";
+   }
+   cout << endl;
+}
+
+// Hook for the unwinder statistics, provided by bin/libunwindstats.so when preloaded
+#ifdef __linux__
+extern "C" void __attribute__((weak)) unwindStatsPhase(const char* name);
+#else
+void (*unwindStatsPhase)(const char*) = nullptr;
+#endif
+
+// The options of a test run
+struct RunOptions {
+   /// Measure the latency of every call?
+   bool latency = false;
+   /// Measure the hardware counters?
+   bool counters = false;
+   /// The runs before the measurement, which are ignored
+   unsigned warmup = 0;
+   /// The measured runs
+   unsigned repetitions = 1;
+   /// The coefficient of variation to reach by repeating the measurement, 0 if it should not be repeated
+   double targetCV = 0;
+
+   /// The minimum number of measured runs. The coefficient of variation of fewer than three runs is meaningless
+   unsigned minRepetitions() const { return targetCV ? max(repetitions, 3u) : repetitions; }
+   /// The maximum number of measured runs when repeating to reach the target
+   unsigned maxRepetitions() const { return targetCV ? 10 * minRepetitions() : repetitions; }
+};
+
+// Print a summary of repeated measurements: median [95% confidence interval] +-MAD, coefficient of variation, runs
+static void printSummary(const Summary& s) {
+   char buffer[128];
+   snprintf(buffer, sizeof(buffer), " %.2f [%.2f,%.2f] +-%.2f cv %.1f%% n%u", s.median, s.ciLow, s.ciHigh, s.mad, s.cv * 100.0, s.count);
+   cout << buffer;
 }
 
-static void runTests(const vector<tuple<const char*, TestedFunctionSqrt, TestedFunctionFib, bool>>& tests, span<const unsigned> threadCounts) {
+static void runTests(const vector<tuple<const char*, TestedFunctionSqrt, TestedFunctionFib, bool>>& tests, span<const unsigned> threadCounts, const RunOptions& options) {
    auto announce = [threadCounts](const char* name) {
       cout << "testing " << name << " using";
       for (auto c : threadCounts) cout << " " << c;
       cout << " threads" << endl;
    };
+   auto phase = [](const char* benchmark, const char* name, unsigned fr, unsigned tc) {
+      if (unwindStatsPhase) unwindStatsPhase((string(benchmark) + " " + name + " " + to_string(fr / 10) + "." + to_string(fr % 10) + "% " + to_string(tc) + " threads").c_str());
+   };
+   vector<pair<PerfValues, CallCounter>> happyPath(threadCounts.size());
+   auto run = [&](const char* benchmark, const char* name, auto func, unsigned fr) {
+      auto warmup = [&](unsigned tc) {
+         for (unsigned index = 0; index != options.warmup; ++index)
+            doTestMultithreaded([func](unsigned errorRate, unsigned id) { return doTest(func, errorRate, id); }, fr, tc);
+      };
+      if (options.latency) {
+         for (auto tc : threadCounts) {
+            cout << "failure rate " << (static_cast<double>(fr) / 10.0) << "%, " << tc << " threads:" << endl;
+            warmup(tc);
+            phase(benchmark, name, fr, tc);
+            doLatencyTest(func, fr, tc, options.minRepetitions());
+         }
+         return;
+      }
+      // Print the longest thread durations, followed by the throughput of all threads in million calls per second.
+      // With repetitions, print a summary of the longest thread durations instead, and the median throughput
+      cout << "failure rate " << (static_cast<double>(fr) / 10.0) << "%:";
+      bool repeated = options.maxRepetitions() > 1;
+      vector<double> throughputs;
+      vector<pair<PerfValues, CallCounter>> measured(threadCounts.size());
+      for (unsigned index = 0; index != threadCounts.size(); ++index) {
+         auto tc = threadCounts[index];
+         warmup(tc);
+         phase(benchmark, name, fr, tc);
+         // The durations in milliseconds, with microsecond resolution for the statistics
+         vector<double> durations, callsPerSecond;
+         do {
+            Measurement m;
+            if (options.counters)
+               m = doCounterTestMultithreaded(func, fr, tc, measured[index].first, measured[index].second);
+            else
+               m = doTestMultithreaded([func](unsigned errorRate, unsigned id) { return doTest(func, errorRate, id); }, fr, tc);
+            durations.push_back(m.maxDuration / 1000.0);
+            callsPerSecond.push_back(m.callsPerSecond);
+         } while ((durations.size() < options.minRepetitions()) || ((durations.size() < options.maxRepetitions()) && (coefficientOfVariation(durations) > options.targetCV)));
+
+         if (repeated) {
+            Random random(index);
+            printSummary(summarize(durations, random));
+         } else {
+            cout << " " << lround(durations.front());
+         }
+         throughputs.push_back(median(callsPerSecond));
+      }
+      cout << " |";
+      for (auto t : throughputs) {
+         char buffer[32];
+         snprintf(buffer, sizeof(buffer), "%.3f", t / 1000000.0);
+         cout << " " << buffer;
+      }
+      cout << " Mcalls/s" << endl;
+
+      // The error-free run is the first one, the later runs compare against it
+      if (options.counters) {
+         if (!fr) happyPath = measured;
+         for (unsigned index = 0; index != threadCounts.size(); ++index)
+            printCounters(threadCounts[index], measured[index].first, measured[index].second, happyPath[index].first, happyPath[index].second);
+      }
+   };
 
    const unsigned failureRates[] = {0, 1, 10, 100};
 
    cout << "Testing unwinding performance: sqrt computation with occasional errors" << endl
         << endl;
    for (auto& t : tests) {
+      if (!get<1>(t)) continue; // the method does not support this scenario
       announce(get<0>(t));
       for (unsigned fr : failureRates) {
-         cout << "failure rate " << (static_cast<double>(fr) / 10.0) << "%:";
-         for (auto tc : threadCounts)
-            cout << " " << doTestMultithreaded([func = get<1>(t)](unsigned errorRate, unsigned id) { return doTest(func, errorRate, id); }, fr, tc);
-         cout << endl;
+         run("sqrt", get<0>(t), get<1>(t), fr);
          if (!get<3>(t))
             break;
       }
@@ -141,17 +446,39 @@ static void runTests(const vector<tuple<const char*, TestedFunctionSqrt, TestedF
    cout << "Testing invocation overhead: recursive fib with occasional errors" << endl
         << endl;
    for (auto& t : tests) {
+      if (!get<2>(t)) continue; // the method does not support this scenario
       announce(get<0>(t));
       for (unsigned fr : failureRates) {
-         cout << "failure rate " << (static_cast<double>(fr) / 10.0) << "%:";
-         for (auto tc : threadCounts)
-            cout << " " << doTestMultithreaded([func = get<2>(t)](unsigned errorRate, unsigned id) { return doTest(func, errorRate, id); }, fr, tc);
-         cout << endl;
+         run("fib", get<0>(t), get<2>(t), fr);
          if (!get<3>(t))
             break;
       }
    }
    cout << endl;
+   if (unwindStatsPhase) unwindStatsPhase("idle");
+}
+
+// Measure the fib computation with results of different sizes
+static void runSizeTests(const vector<pair<const char*, TestedFunctionSizedFib>>& tests, span<const unsigned> threadCounts) {
+   const unsigned failureRates[] = {0, 1, 10, 100};
+   const unsigned sizes[] = {4, 8, 16, 32, 64};
+
+   cout << "Testing result size overhead: recursive fib returning values of 4 to 64 bytes" << endl
+        << endl;
+   for (auto& t : tests) {
+      cout << "testing " << t.first << " using sizes";
+      for (auto s : sizes) cout << " " << s;
+      cout << endl;
+      for (auto tc : threadCounts) {
+         for (unsigned fr : failureRates) {
+            cout << tc << " threads, failure rate " << (static_cast<double>(fr) / 10.0) << "%:";
+            for (auto s : sizes)
+               cout << " " << toMilliseconds(doTestMultithreaded([func = t.second, s](unsigned errorRate, unsigned id) { return doTest(func, s, errorRate, id); }, fr, tc).maxDuration);
+            cout << endl;
+         }
+      }
+   }
+   cout << endl;
 }
 
 static vector<unsigned> buildThreadCounts(unsigned maxCount) {
@@ -160,6 +487,61 @@ static vector<unsigned> buildThreadCounts(unsigned maxCount) {
    return threadCounts;
 }
 
+static unsigned interpretNumber(string_view desc) {
+   unsigned result = 0;
+   from_chars(desc.data(), desc.data() + desc.length(), result);
+   return result;
+}
+
+static double interpretFraction(string_view desc) {
+   double result = 0;
+   from_chars(desc.data(), desc.data() + desc.length(), result);
+   return max(result, 0.0);
+}
+
+static vector<string_view> interpretPlacements(string_view desc) {
+   vector<string_view> placements;
+   while (!desc.empty()) {
+      auto split = min(desc.find(' '), desc.length());
+      auto p = desc.substr(0, split);
+      if (p == "all") {
+         placements.insert(placements.end(), Topology::policies().begin(), Topology::policies().end());
+      } else if (!p.empty()) {
+         placements.push_back(p);
+      }
+      desc = desc.substr(min(split + 1, desc.length()));
+   }
+   return placements;
+}
+
+// Call f with the thread counts once for every placement policy, or once without a specific placement.
+// Thread counts that exceed the CPUs of a placement are dropped for that placement
+template <class F>
+static void forEachPlacement(const Topology& topology, span<const string_view> placements, span<const unsigned> threadCounts, F&& f) {
+   if (placements.empty()) {
+      f(threadCounts);
+      return;
+   }
+   for (auto p : placements) {
+      auto cpus = topology.place(p);
+      cout << "placement " << p << " using cpus";
+      for (auto c : cpus) cout << " " << c;
+      cout << endl
+           << endl;
+      vector<unsigned> fitting;
+      for (auto tc : threadCounts)
+         if (tc <= cpus.size()) fitting.push_back(tc);
+      if (fitting.empty()) {
+         cout << "no thread count fits into the placement" << endl
+              << endl;
+         continue;
+      }
+      WorkerPool::get().setPlacement(move(cpus));
+      f(span<const unsigned>(fitting));
+   }
+   WorkerPool::get().setPlacement({});
+}
+
 static vector<unsigned> interpretThreadCounts(string_view desc) {
    vector<unsigned> threadCounts;
    auto add = [&](string_view desc) {
@@ -176,23 +558,41 @@ static vector<unsigned> interpretThreadCounts(string_view desc) {
    return threadCounts;
 }
 
-vector<tuple<const char*, TestedFunctionSqrt, TestedFunctionFib, bool>> tests = {{"baseline", &baselineSqrt, &baselineFib, false}, {"exceptions", &exceptionsSqrt, &exceptionsFib, true}, {"LEAF", &leafResultSqrt, &leafResultFib, true}, {"std::expected", &expectedSqrt, &expectedFib, true}, {"herbceptionemulation", &herbceptionEmulationSqrt, &herbceptionEmulationFib, true}, {"herbceptions", &herbceptionsSqrt, &herbceptionsFib, true}, {"outcome", &outcomeResultSqrt, &outcomeResultFib, true}};
+vector<tuple<const char*, TestedFunctionSqrt, TestedFunctionFib, bool>> tests = {{"baseline", &baselineSqrt, &baselineFib, false}, {"exceptions", &exceptionsSqrt, &exceptionsFib, true}, {"exceptions-memoized", &exceptionsMemoizedSqrt, &exceptionsMemoizedFib, true}, {"exceptions-pooled", &exceptionsPooledSqrt, &exceptionsPooledFib, true}, {"exceptions-sjlj", &sjljExceptionsSqrt, &sjljExceptionsFib, true}, {"LEAF", &leafResultSqrt, &leafResultFib, true}, {"LEAF-idblocks", &leafResultSqrtIdBlocks, &leafResultFibIdBlocks, true}, {"LEAF-capture", &leafResultSqrtCapture, &leafResultFibCapture, true}, {"LEAF-exceptions", &leafResultSqrtExceptions, &leafResultFibExceptions, true}, {"LEAF-diagnostics", &leafResultSqrtDiagnostics, &leafResultFibDiagnostics, true}, {"std::expected", &expectedSqrt, &expectedFib, true}, {"std::expected-batch", &expectedBatchSqrt, nullptr, true}, {"std::expected(libstdc++)", &stdExpectedSqrt, &stdExpectedFib, true}, {"herbceptionemulation", &herbceptionEmulationSqrt, &herbceptionEmulationFib, true}, {"herbceptionemulation-exceptions", &herbceptionEmulationSqrtExceptions, &herbceptionEmulationFibExceptions, true}, {"herbceptionemulation-handle", &herbceptionEmulationSqrt, &herbceptionEmulationHandleFib, true}, {"herbceptionemulation-relocatable", &herbceptionEmulationSqrt, &herbceptionEmulationRelocatableHandleFib, true}, {"herbceptionemulation-domain", &herbceptionEmulationDomainSqrt, &herbceptionEmulationDomainFib, true}, {"herbceptionemulation-monadic", &herbceptionEmulationSqrt, &herbceptionEmulationMonadicFib, true}, {"herbceptionemulation-batch", &herbceptionEmulationBatchSqrt, nullptr, true}, {"herbceptions", &herbceptionsSqrt, &herbceptionsFib, true}, {"altreturn", &altReturnSqrt, &altReturnFib, true}, {"outcome", &outcomeResultSqrt, &outcomeResultFib, true}, {"outcome-narrow", &outcomeResultSqrtNarrow, &outcomeResultFibNarrow, true}, {"outcome-exceptions", &outcomeResultSqrtExceptions, &outcomeResultFibExceptions, true}, {"errnoslot", &errnoSlotSqrt, &errnoSlotFib, true}, {"errnoslot-accessor", &errnoSlotAccessorSqrt, &errnoSlotAccessorFib, true}, {"errnoslot-ie", &errnoSlotInitialExecSqrt, &errnoSlotInitialExecFib, true}, {"errnoslot-gd", &errnoSlotGeneralDynamicSqrt, &errnoSlotGeneralDynamicFib, true}, {"coroutine", &coroutineSqrt, &coroutineFib, true}, {"coroutine-arena", &coroutineArenaSqrt, &coroutineArenaFib, true}, {"coroutine-rootjump", &coroutineRootJumpSqrt, &coroutineRootJumpFib, true}, {"coroutine-arena-rootjump", &coroutineArenaRootJumpSqrt, &coroutineArenaRootJumpFib, true}, {"classify-category", &classifyCategorySqrt, &classifyCategoryFib, true}, {"classify-domain", &classifyDomainSqrt, &classifyDomainFib, true}, {"poison", &poisonSqrt, &poisonFib, true}, {"baseline-simd", &baselineSimdSqrt, nullptr, false}, {"exceptions-simd", &exceptionsSimdSqrt, nullptr, true}, {"LEAF-simd", &leafResultSimdSqrt, nullptr, true}, {"std::expected-simd", &expectedSimdSqrt, nullptr, true}, {"herbceptionemulation-simd", &herbceptionEmulationSimdSqrt, nullptr, true}, {"outcome-simd", &outcomeResultSimdSqrt, nullptr, true}};
+
+vector<pair<const char*, TestedFunctionSizedFib>> sizeTests = {{"exceptions", &exceptionsSizedFib}, {"LEAF", &leafResultSizedFib}, {"LEAF-idblocks", &leafResultSizedFibIdBlocks}, {"LEAF-capture", &leafResultSizedFibCapture}, {"LEAF-exceptions", &leafResultSizedFibExceptions}, {"LEAF-diagnostics", &leafResultSizedFibDiagnostics}, {"std::expected", &expectedSizedFib}, {"std::expected(libstdc++)", &stdExpectedSizedFib}, {"herbceptionemulation", &herbceptionEmulationSizedFib}, {"herbceptionemulation-exceptions", &herbceptionEmulationSizedFibExceptions}, {"herbceptionemulation-niche", &herbceptionEmulationNicheSizedFib}, {"outcome", &outcomeResultSizedFib}, {"outcome-narrow", &outcomeResultSizedFibNarrow}, {"outcome-exceptions", &outcomeResultSizedFibExceptions}};
 
-// Hook for the experimental lockfree unwinding logic
+// Hooks for the experimental lockfree unwinding logic, provided by fdelookup.cpp or by a patched libgcc
 #ifdef __linux__
 extern "C" int __attribute__((weak)) __libunwind_btreelookup_sync();
+extern "C" int __attribute__((weak)) __libunwind_fdecache_enable();
 #else
 void (*__libunwind_btreelookup_sync)() = nullptr;
+void (*__libunwind_fdecache_enable)() = nullptr;
 #endif
 
 
 int main(int argc, char* argv[]) {
-   vector<unsigned> threadCounts = buildThreadCounts(thread::hardware_concurrency() / 2); // assuming half are hyperthreads. We can override that below
-   bool explicitRun = false;
+   auto topology = Topology::read();
+   vector<unsigned> threadCounts = buildThreadCounts(topology.coreCount()); // one thread per physical core. We can override that below
+   WorkerPool::get().setDefaultPlacement(topology.defaultPlacement()); // and pin them to distinct physical cores
+   vector<string_view> placements;
+   bool explicitRun = false, sizeRun = false;
+   RunOptions options;
+   vector<pair<const char*, TestedFunctionSizedFib>> selectedSizeTests;
    for (int index = 1; index < argc; ++index) {
       string_view o = argv[index];
       if ((o == "--threads") && (index + 1 < argc)) {
          threadCounts = interpretThreadCounts(argv[++index]);
+      } else if ((o == "--placement") && (index + 1 < argc)) {
+         placements = interpretPlacements(argv[++index]);
+         for (auto p : placements)
+            if (topology.place(p).empty()) {
+               cout << "unknown placement " << p << ", supported are all";
+               for (auto s : Topology::policies()) cout << " " << s;
+               cout << endl;
+               return 1;
+            }
       } else if (o == "--lockfree") {
          if (!__libunwind_btreelookup_sync) {
             cout << "lockfree unwinding not supported on this platform" << endl;
@@ -200,14 +600,47 @@ int main(int argc, char* argv[]) {
          } else {
             __libunwind_btreelookup_sync();
          }
+      } else if (o == "--fdecache") {
+         if (!__libunwind_fdecache_enable) {
+            cout << "unwinder lookup cache not supported on this platform" << endl;
+            return 1;
+         } else {
+            __libunwind_fdecache_enable();
+         }
+      } else if (o == "--sizes") {
+         sizeRun = true;
+      } else if (o == "--latency") {
+         options.latency = true;
+      } else if (o == "--counters") {
+         if (!PerfCounters().valid()) {
+            cout << "performance counters not available on this platform" << endl;
+            return 1;
+         }
+         options.counters = true;
+      } else if ((o == "--warmup") && (index + 1 < argc)) {
+         options.warmup = interpretNumber(argv[++index]);
+      } else if ((o == "--repeat") && (index + 1 < argc)) {
+         options.repetitions = max(interpretNumber(argv[++index]), 1u);
+      } else if ((o == "--cv") && (index + 1 < argc)) {
+         // The target is given in percent, e.g., 2.5
+         options.targetCV = interpretFraction(argv[++index]) / 100.0;
       } else {
          bool found = false;
-         for (auto& t : tests)
-            if (get<0>(t) == o) {
-               runTests({t}, threadCounts);
-               found = true;
-               break;
-            }
+         if (sizeRun) {
+            for (auto& t : sizeTests)
+               if (t.first == o) {
+                  selectedSizeTests.push_back(t);
+                  found = true;
+                  break;
+               }
+         } else {
+            for (auto& t : tests)
+               if (get<0>(t) == o) {
+                  forEachPlacement(topology, placements, threadCounts, [&](span<const unsigned> tc) { runTests({t}, tc, options); });
+                  found = true;
+                  break;
+               }
+         }
          if (!found) {
             cout << "unknown method " << o << endl;
             return 1;
@@ -215,7 +648,9 @@ int main(int argc, char* argv[]) {
          explicitRun = true;
       }
    }
-   if (!explicitRun) {
-      runTests(tests, threadCounts);
+   if (sizeRun) {
+      forEachPlacement(topology, placements, threadCounts, [&](span<const unsigned> tc) { runSizeTests(explicitRun ? selectedSizeTests : sizeTests, tc); });
+   } else if (!explicitRun) {
+      forEachPlacement(topology, placements, threadCounts, [&](span<const unsigned> tc) { runTests(tests, tc, options); });
    }
 }
@@ -8,16 +8,71 @@ unsigned baselineSqrt(span<double> values, unsigned repeat);
 unsigned baselineFib(unsigned n, unsigned maxDepth);
 unsigned exceptionsSqrt(span<double> values, unsigned repeat);
 unsigned exceptionsFib(unsigned n, unsigned maxDepth);
+unsigned sjljExceptionsSqrt(span<double> values, unsigned repeat);
+unsigned sjljExceptionsFib(unsigned n, unsigned maxDepth);
 unsigned leafResultSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned leafResultFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtIdBlocks(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibIdBlocks(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtCapture(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibCapture(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtExceptions(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibExceptions(unsigned n, unsigned maxDepth) noexcept;
+unsigned leafResultSqrtDiagnostics(span<double> values, unsigned repeat) noexcept;
+unsigned leafResultFibDiagnostics(unsigned n, unsigned maxDepth) noexcept;
 unsigned expectedSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned expectedFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned expectedBatchSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned stdExpectedSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned stdExpectedFib(unsigned n, unsigned maxDepth) noexcept;
 unsigned herbceptionEmulationSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned herbceptionEmulationFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationHandleFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationRelocatableHandleFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationDomainSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationDomainFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationMonadicFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned herbceptionEmulationBatchSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationSqrtExceptions(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationFibExceptions(unsigned n, unsigned maxDepth) noexcept;
 unsigned herbceptionsSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned herbceptionsFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned altReturnSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned altReturnFib(unsigned n, unsigned maxDepth) noexcept;
 unsigned outcomeResultSqrt(span<double> values, unsigned repeat) noexcept;
 unsigned outcomeResultFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned outcomeResultSqrtNarrow(span<double> values, unsigned repeat) noexcept;
+unsigned outcomeResultFibNarrow(unsigned n, unsigned maxDepth) noexcept;
+unsigned outcomeResultSqrtExceptions(span<double> values, unsigned repeat) noexcept;
+unsigned outcomeResultFibExceptions(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotAccessorSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotAccessorFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotInitialExecSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotInitialExecFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned errnoSlotGeneralDynamicSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned errnoSlotGeneralDynamicFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineArenaSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineArenaFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineRootJumpSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineRootJumpFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned coroutineArenaRootJumpSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned coroutineArenaRootJumpFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned classifyCategorySqrt(span<double> values, unsigned repeat) noexcept;
+unsigned classifyCategoryFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned classifyDomainSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned classifyDomainFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned poisonSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned poisonFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned baselineSimdSqrt(span<double> values, unsigned repeat);
+unsigned exceptionsSimdSqrt(span<double> values, unsigned repeat);
+unsigned leafResultSimdSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned expectedSimdSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned herbceptionEmulationSimdSqrt(span<double> values, unsigned repeat) noexcept;
+unsigned outcomeResultSimdSqrt(span<double> values, unsigned repeat) noexcept;
 
 using TestedFunctionSqrt = unsigned (*)(span<double>, unsigned);
 using TestedFunctionFib = unsigned (*)(unsigned, unsigned);
@@ -116,22 +171,57 @@ int main(int argc, char** argv) {
    };
 
    constexpr array<unsigned, 4> failureRates = {0, 1, 10, 100};
-   constexpr array<tuple<const char*, TestedFunctionSqrt, TestedFunctionFib>, 6> tests = {
+   constexpr array<tuple<const char*, TestedFunctionSqrt, TestedFunctionFib>, 38> tests = {
       tuple{"exceptions", &exceptionsSqrt, &exceptionsFib},
+      tuple{"exceptions-sjlj", &sjljExceptionsSqrt, &sjljExceptionsFib},
       tuple{"LEAF", &leafResultSqrt, &leafResultFib},
+      tuple{"LEAF-idblocks", &leafResultSqrtIdBlocks, &leafResultFibIdBlocks},
+      tuple{"LEAF-capture", &leafResultSqrtCapture, &leafResultFibCapture},
+      tuple{"LEAF-exceptions", &leafResultSqrtExceptions, &leafResultFibExceptions},
+      tuple{"LEAF-diagnostics", &leafResultSqrtDiagnostics, &leafResultFibDiagnostics},
       tuple{"std::expected", &expectedSqrt, &expectedFib},
+      tuple{"std::expected-batch", &expectedBatchSqrt, nullptr},
+      tuple{"std::expected(libstdc++)", &stdExpectedSqrt, &stdExpectedFib},
       tuple{"herbceptionemulation", &herbceptionEmulationSqrt, &herbceptionEmulationFib},
+      tuple{"herbceptionemulation-exceptions", &herbceptionEmulationSqrtExceptions, &herbceptionEmulationFibExceptions},
+      tuple{"herbceptionemulation-handle", &herbceptionEmulationSqrt, &herbceptionEmulationHandleFib},
+      tuple{"herbceptionemulation-relocatable", &herbceptionEmulationSqrt, &herbceptionEmulationRelocatableHandleFib},
+      tuple{"herbceptionemulation-domain", &herbceptionEmulationDomainSqrt, &herbceptionEmulationDomainFib},
+      tuple{"herbceptionemulation-monadic", &herbceptionEmulationSqrt, &herbceptionEmulationMonadicFib},
+      tuple{"herbceptionemulation-batch", &herbceptionEmulationBatchSqrt, nullptr},
       tuple{"herbceptions", &herbceptionsSqrt, &herbceptionsFib},
-      tuple{"outcome", &outcomeResultSqrt, &outcomeResultFib}};
+      tuple{"altreturn", &altReturnSqrt, &altReturnFib},
+      tuple{"outcome", &outcomeResultSqrt, &outcomeResultFib},
+      tuple{"outcome-narrow", &outcomeResultSqrtNarrow, &outcomeResultFibNarrow},
+      tuple{"outcome-exceptions", &outcomeResultSqrtExceptions, &outcomeResultFibExceptions},
+      tuple{"errnoslot", &errnoSlotSqrt, &errnoSlotFib},
+      tuple{"errnoslot-accessor", &errnoSlotAccessorSqrt, &errnoSlotAccessorFib},
+      tuple{"errnoslot-ie", &errnoSlotInitialExecSqrt, &errnoSlotInitialExecFib},
+      tuple{"errnoslot-gd", &errnoSlotGeneralDynamicSqrt, &errnoSlotGeneralDynamicFib},
+      tuple{"coroutine", &coroutineSqrt, &coroutineFib},
+      tuple{"coroutine-arena", &coroutineArenaSqrt, &coroutineArenaFib},
+      tuple{"coroutine-rootjump", &coroutineRootJumpSqrt, &coroutineRootJumpFib},
+      tuple{"coroutine-arena-rootjump", &coroutineArenaRootJumpSqrt, &coroutineArenaRootJumpFib},
+      tuple{"classify-category", &classifyCategorySqrt, &classifyCategoryFib},
+      tuple{"classify-domain", &classifyDomainSqrt, &classifyDomainFib},
+      tuple{"poison", &poisonSqrt, &poisonFib},
+      tuple{"exceptions-simd", &exceptionsSimdSqrt, nullptr},
+      tuple{"LEAF-simd", &leafResultSimdSqrt, nullptr},
+      tuple{"std::expected-simd", &expectedSimdSqrt, nullptr},
+      tuple{"herbceptionemulation-simd", &herbceptionEmulationSimdSqrt, nullptr},
+      tuple{"outcome-simd", &outcomeResultSimdSqrt, nullptr}};
 
    configureBenchmark(benchmark::RegisterBenchmark("SQRT_baseline", BM_sqrt, &baselineSqrt), array<unsigned, 1>{0});
+   configureBenchmark(benchmark::RegisterBenchmark("SQRT_baseline-simd", BM_sqrt, &baselineSimdSqrt), array<unsigned, 1>{0});
    for (auto test : tests) {
+      if (!get<1>(test)) continue;
       string name = string("SQRT_") + get<0>(test);
       configureBenchmark(benchmark::RegisterBenchmark(name.c_str(), BM_sqrt, get<1>(test)), failureRates);
    }
 
    configureBenchmark(benchmark::RegisterBenchmark("FIB_baseline", BM_fib, &baselineFib), array<unsigned, 1>{0});
    for (auto test : tests) {
+      if (!get<2>(test)) continue;
       string name = string("FIB_") + get<0>(test);
       configureBenchmark(benchmark::RegisterBenchmark(name.c_str(), BM_fib, get<2>(test)), failureRates);
    }
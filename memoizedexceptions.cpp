@@ -0,0 +1,250 @@
+#include <cmath>
+#include <span>
+
+// An experimental "memoized two-phase" throw. A C++ throw first searches for the handler and then
+// unwinds to it in a second pass. When a throw site is reached through the same call stack again,
+// the search phase finds the same handler again. We remember the handler found by the first throw
+// and let later throws start with the cleanup phase directly, falling back to a regular throw when
+// the call stack differs.
+// The call stack is identified by walking the frame pointers, thus every frame between the throw and
+// the catch must maintain a frame pointer. This file is compiled with -fno-omit-frame-pointer for that reason.
+
+struct InvalidValue {};
+
+#if defined(__linux__) && defined(__x86_64__) && defined(__GLIBCXX__)
+#include <algorithm>
+#include <cstdint>
+#include <cxxabi.h>
+#include <exception>
+#include <new>
+#include <typeinfo>
+#include <pthread.h>
+#include <unwind.h>
+
+unsigned loadedObjectsGeneration() noexcept;
+
+namespace {
+
+/// Mirrors __cxa_exception from libstdc++
+struct CxaException {
+   std::type_info* exceptionType;
+   void (*exceptionDestructor)(void*);
+   void (*unexpectedHandler)();
+   void (*terminateHandler)();
+   CxaException* nextException;
+   int handlerCount;
+   int handlerSwitchValue;
+   const unsigned char* actionRecord;
+   const unsigned char* languageSpecificData;
+   _Unwind_Ptr catchTemp;
+   void* adjustedPtr;
+   _Unwind_Exception unwindHeader;
+};
+/// Mirrors __cxa_refcounted_exception from libstdc++
+struct CxaRefcountedException {
+   int referenceCount;
+   CxaException exc;
+};
+/// Mirrors __cxa_eh_globals from libstdc++
+struct CxaEhGlobals {
+   CxaException* caughtExceptions;
+   unsigned uncaughtExceptions;
+};
+
+/// The maximum number of frames between throw and catch
+constexpr unsigned maxFrames = 32;
+
+/// A memoized path from a throw site to its handler
+struct ThrowPath {
+   /// The return addresses of all frames between throw and catch, the first one is the throw site
+   uintptr_t returnAddresses[maxFrames];
+   /// The number of return addresses
+   unsigned frameCount;
+   /// The generation of loaded objects when the path was recorded
+   unsigned generation;
+   /// The thrown type
+   const std::type_info* type;
+   /// The canonical frame address of the handler frame, as identified by the unwinder
+   _Unwind_Word handlerCfa;
+   /// The state that the personality routine computed during the search phase
+   int handlerSwitchValue;
+   const unsigned char* actionRecord;
+   const unsigned char* languageSpecificData;
+   _Unwind_Ptr catchTemp;
+   ptrdiff_t adjustment;
+};
+
+/// The frames seen by a throw that took the regular path
+struct PendingThrow {
+   _Unwind_Exception* exception;
+   uintptr_t cfas[maxFrames];
+   uintptr_t returnAddresses[maxFrames];
+   unsigned frameCount;
+};
+
+/// The number of memoized paths per thread
+constexpr unsigned throwPathCount = 16;
+/// The memoized paths, direct-mapped by throw site
+static thread_local ThrowPath throwPaths[throwPathCount];
+/// The last regular throw of the current thread
+static thread_local PendingThrow pendingThrow;
+/// The stack of the current thread, frame pointers outside are invalid
+static thread_local uintptr_t stackLow, stackHigh;
+
+/// Check if a frame pointer can be followed
+static bool validFrame(uintptr_t fp, uintptr_t previous) {
+   if (!stackHigh) {
+      pthread_attr_t attr;
+      void* addr;
+      size_t size;
+      pthread_getattr_np(pthread_self(), &attr);
+      pthread_attr_getstack(&attr, &addr, &size);
+      pthread_attr_destroy(&attr);
+      stackLow = reinterpret_cast<uintptr_t>(addr);
+      stackHigh = stackLow + size;
+   }
+   return (fp > previous) && (fp >= stackLow) && (fp + 2 * sizeof(uintptr_t) <= stackHigh) && (!(fp & (sizeof(uintptr_t) - 1)));
+}
+
+/// Check if the current call stack matches a memoized path
+static bool matches(const ThrowPath& path, uintptr_t fp, const std::type_info* type) {
+   if ((!path.frameCount) || (path.type != type) || (path.generation != loadedObjectsGeneration())) return false;
+   uintptr_t previous = 0;
+   for (unsigned index = 0; index != path.frameCount; ++index) {
+      if ((!validFrame(fp, previous)) || (reinterpret_cast<uintptr_t*>(fp)[1] != path.returnAddresses[index])) return false;
+      previous = fp;
+      fp = reinterpret_cast<uintptr_t*>(fp)[0];
+   }
+   return validFrame(fp, previous) && (fp + 2 * sizeof(uintptr_t) == path.handlerCfa);
+}
+
+/// Record the call stack of a regular throw
+static void recordFrames(_Unwind_Exception* exception, uintptr_t fp) {
+   auto& pending = pendingThrow;
+   pending.exception = exception;
+   pending.frameCount = 0;
+   uintptr_t previous = 0;
+   while ((pending.frameCount != maxFrames) && validFrame(fp, previous)) {
+      pending.cfas[pending.frameCount] = fp + 2 * sizeof(uintptr_t);
+      pending.returnAddresses[pending.frameCount] = reinterpret_cast<uintptr_t*>(fp)[1];
+      ++pending.frameCount;
+      previous = fp;
+      fp = reinterpret_cast<uintptr_t*>(fp)[0];
+   }
+}
+
+/// Throw an exception object created by __cxa_allocate_exception
+[[noreturn]] static void __attribute__((noinline)) raiseMemoized(void* object, std::type_info* type, void (*destructor)(void*)) {
+   auto header = reinterpret_cast<CxaRefcountedException*>(__cxxabiv1::__cxa_init_primary_exception(object, type, destructor));
+   header->referenceCount = 1;
+   ++reinterpret_cast<CxaEhGlobals*>(__cxxabiv1::__cxa_get_globals())->uncaughtExceptions;
+   _Unwind_Exception* exception = &header->exc.unwindHeader;
+
+   auto fp = reinterpret_cast<uintptr_t>(__builtin_frame_address(0));
+   uintptr_t throwSite = reinterpret_cast<uintptr_t*>(fp)[1];
+   auto& path = throwPaths[(throwSite >> 4) % throwPathCount];
+   if (matches(path, fp, type)) {
+      // Restore what the search phase would have computed and go directly to the cleanup phase.
+      // _Unwind_Resume unwinds until it reaches the frame identified by private_2
+      header->exc.handlerSwitchValue = path.handlerSwitchValue;
+      header->exc.actionRecord = path.actionRecord;
+      header->exc.languageSpecificData = path.languageSpecificData;
+      header->exc.catchTemp = path.catchTemp;
+      header->exc.adjustedPtr = static_cast<char*>(object) + path.adjustment;
+      exception->private_1 = 0;
+      exception->private_2 = path.handlerCfa;
+      _Unwind_Resume(exception);
+   }
+
+   recordFrames(exception, fp);
+   _Unwind_RaiseException(exception);
+
+   // Unwinding failed, behave like __cxa_throw
+   __cxxabiv1::__cxa_begin_catch(exception);
+   std::terminate();
+}
+
+/// Throw a value, memoizing the path to the handler
+template <class T>
+[[noreturn]] static void throwMemoized(T value) {
+   void* object = __cxxabiv1::__cxa_allocate_exception(sizeof(T));
+   new (object) T(std::move(value));
+   raiseMemoized(object, const_cast<std::type_info*>(&typeid(T)), [](void* p) { static_cast<T*>(p)->~T(); });
+}
+
+/// Remember where the currently handled exception was caught. Must be called from within the catch block
+static void memoizeCaught() noexcept {
+   auto& pending = pendingThrow;
+   CxaException* caught = reinterpret_cast<CxaEhGlobals*>(__cxxabiv1::__cxa_get_globals())->caughtExceptions;
+   if ((!caught) || (&caught->unwindHeader != pending.exception)) return;
+   pending.exception = nullptr;
+
+   // Find the handler frame among the recorded frames
+   _Unwind_Word handlerCfa = caught->unwindHeader.private_2;
+   unsigned frameCount = 0;
+   while ((frameCount != pending.frameCount) && (pending.cfas[frameCount] != handlerCfa)) ++frameCount;
+   if ((frameCount == pending.frameCount) || (!frameCount)) return;
+
+   auto& path = throwPaths[(pending.returnAddresses[0] >> 4) % throwPathCount];
+   std::copy(pending.returnAddresses, pending.returnAddresses + frameCount, path.returnAddresses);
+   path.frameCount = frameCount;
+   path.generation = loadedObjectsGeneration();
+   path.type = caught->exceptionType;
+   path.handlerCfa = handlerCfa;
+   path.handlerSwitchValue = caught->handlerSwitchValue;
+   path.actionRecord = caught->actionRecord;
+   path.languageSpecificData = caught->languageSpecificData;
+   path.catchTemp = caught->catchTemp;
+   path.adjustment = static_cast<char*>(caught->adjustedPtr) - reinterpret_cast<char*>(&caught->unwindHeader + 1);
+}
+
+}
+
+#define THROW(x) throwMemoized(x)
+#define MEMOIZE() memoizeCaught()
+
+#else
+#warning No memoized throw implementation provided for this platform, falling back to regular exceptions
+
+#define THROW(x) throw x
+#define MEMOIZE()
+#endif
+
+static void doSqrt(std::span<double> values) __attribute__((noinline));
+static void doSqrt(std::span<double> values) {
+   for (auto& v : values) {
+      if (v < 0) THROW(InvalidValue{});
+      v = sqrt(v);
+   }
+}
+
+unsigned exceptionsMemoizedSqrt(std::span<double> values, unsigned repeat) {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      try {
+         doSqrt(values);
+      } catch (const InvalidValue& v) {
+         MEMOIZE();
+         ++failures;
+      }
+   }
+   return failures;
+}
+
+// prevent the compile from recognizing and compiling away the fib logic
+static unsigned doFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("-O1", "no-omit-frame-pointer")));
+
+static unsigned doFib(unsigned n, unsigned maxDepth) {
+   if (!maxDepth) THROW(InvalidValue());
+   if (n <= 2) return 1;
+   return doFib(n - 2, maxDepth - 1) + doFib(n - 1, maxDepth - 1);
+}
+
+unsigned exceptionsMemoizedFib(unsigned n, unsigned maxDepth) {
+   try {
+      return doFib(n, maxDepth);
+   } catch (const InvalidValue&) {
+      MEMOIZE();
+      return 0;
+   }
+}
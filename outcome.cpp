@@ -1,10 +1,13 @@
 #include "thirdparty/outcome/outcome.hpp"
+#include "buildvariant.hpp"
+#include "simdsqrt.hpp"
+#include "sizedvalue.hpp"
 #include <cmath>
 #include <span>
 
 namespace outcome = outcome_v2_e261cebd;
 
-#if 0
+#ifdef OUTCOME_ENUM_ERRORS
 // This here is faster, but really minimal in expressiveness
 enum class ErrorCode {
     InvalidValue
@@ -28,7 +31,7 @@ static result<void> doSqrt(std::span<double> values) noexcept {
     return outcome::success();
 }
 
-unsigned outcomeResultSqrt(std::span<double> values, unsigned repeat) noexcept {
+unsigned VARIANT_NAME(outcomeResultSqrt)(std::span<double> values, unsigned repeat) noexcept {
     unsigned failures = 0;
     for (unsigned index = 0; index != repeat; ++index) {
         if (result<void> r = doSqrt(values); !r)
@@ -37,6 +40,22 @@ unsigned outcomeResultSqrt(std::span<double> values, unsigned repeat) noexcept {
     return failures;
 }
 
+// The same with a vectorized kernel, which raises the error once for all values
+static result<void> doSimdSqrt(std::span<double> values) noexcept __attribute__((noinline));
+static result<void> doSimdSqrt(std::span<double> values) noexcept {
+    if (!simdSqrt(values)) DOTHROW();
+    return outcome::success();
+}
+
+unsigned VARIANT_NAME(outcomeResultSimdSqrt)(std::span<double> values, unsigned repeat) noexcept {
+    unsigned failures = 0;
+    for (unsigned index = 0; index != repeat; ++index) {
+        if (result<void> r = doSimdSqrt(values); !r)
+            ++failures;
+    }
+    return failures;
+}
+
 static result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
 static result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept {
     if (!maxDepth) DOTHROW();
@@ -46,9 +65,28 @@ static result<unsigned> doFib(unsigned n, unsigned maxDepth) noexcept {
     return n2 + n1;
 }
 
-unsigned outcomeResultFib(unsigned n, unsigned maxDepth) noexcept {
+unsigned VARIANT_NAME(outcomeResultFib)(unsigned n, unsigned maxDepth) noexcept {
     if (result<unsigned> r = doFib(n, maxDepth))
         return r.value();
     else
         return 0;
 }
+
+template <unsigned size>
+static result<SizedValue<size>> doSizedFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <unsigned size>
+static result<SizedValue<size>> doSizedFib(unsigned n, unsigned maxDepth) noexcept {
+    if (!maxDepth) DOTHROW();
+    if (n <= 2) return makeSizedValue<SizedValue<size>>(1);
+    auto n2 = OUTCOME_TRYX(doSizedFib<size>(n - 2, maxDepth - 1));
+    auto n1 = OUTCOME_TRYX(doSizedFib<size>(n - 1, maxDepth - 1));
+    return makeSizedValue<SizedValue<size>>(n2.value + n1.value);
+}
+
+unsigned VARIANT_NAME(outcomeResultSizedFib)(unsigned size, unsigned n, unsigned maxDepth) noexcept {
+    return dispatchResultSize(size, [&]<unsigned s>() -> unsigned {
+        if (result<SizedValue<s>> r = doSizedFib<s>(n, maxDepth))
+            return r.value().value;
+        return 0;
+    });
+}
@@ -0,0 +1,83 @@
+#include "perfcounters.hpp"
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* const perfEventNames[PerfEventCount] = {"cycles", "instructions", "branch-misses", "L1-icache-misses", "context-switches"};
+
+#ifdef __linux__
+
+/// Open one event of the calling thread. Counts in user space only, unless the event happens in the kernel
+static int openEvent(uint32_t type, uint64_t config, bool kernel, int group) {
+   perf_event_attr attr;
+   memset(&attr, 0, sizeof(attr));
+   attr.size = sizeof(attr);
+   attr.type = type;
+   attr.config = config;
+   attr.disabled = (group == -1);
+   attr.exclude_kernel = !kernel;
+   attr.exclude_hv = 1;
+   attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+   return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+
+PerfCounters::PerfCounters() {
+   // Context switches are recorded in kernel context and would always read 0 in user space only
+   static constexpr struct {
+      uint32_t type;
+      uint64_t config;
+      bool kernel;
+   } events[PerfEventCount] = {
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false},
+      {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, false},
+      {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1I | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16), false},
+      {PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES, true}};
+
+   // The first event that opens leads the group, events that cannot join are skipped
+   for (unsigned index = 0; index != PerfEventCount; ++index) {
+      fds[index] = openEvent(events[index].type, events[index].config, events[index].kernel, opened ? fds[order[0]] : -1);
+      if (fds[index] >= 0) order[opened++] = index;
+   }
+}
+
+PerfCounters::~PerfCounters() {
+   for (int fd : fds)
+      if (fd >= 0) close(fd);
+}
+
+void PerfCounters::start() {
+   if (!opened) return;
+   ioctl(fds[order[0]], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+   ioctl(fds[order[0]], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+void PerfCounters::stop(PerfValues& values) {
+   if (!opened) return;
+   ioctl(fds[order[0]], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+   // The layout of PERF_FORMAT_GROUP: count, time enabled, time running, values
+   uint64_t buffer[3 + PerfEventCount];
+   if (read(fds[order[0]], buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + opened) * sizeof(uint64_t))) return;
+   if (!buffer[2]) return; // never scheduled
+   double scale = static_cast<double>(buffer[1]) / static_cast<double>(buffer[2]);
+   for (unsigned index = 0; index != opened; ++index) {
+      values.counts[order[index]] += static_cast<double>(buffer[3 + index]) * scale;
+      values.available[order[index]] = true;
+   }
+}
+
+#else
+
+PerfCounters::PerfCounters() {
+   for (int& fd : fds) fd = -1;
+}
+PerfCounters::~PerfCounters() {}
+void PerfCounters::start() {}
+void PerfCounters::stop(PerfValues&) {}
+
+#endif
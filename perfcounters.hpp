@@ -0,0 +1,62 @@
+#ifndef H_perfcounters
+#define H_perfcounters
+
+#include <cstdint>
+
+// Hardware performance counters of the calling thread, using perf_event_open on Linux. Events that cannot be
+// opened (missing permissions, no PMU in a VM, other platforms) are reported as unavailable
+
+/// The counted events
+enum PerfEvent { Cycles,
+                 Instructions,
+                 BranchMisses,
+                 L1ICacheMisses,
+                 ContextSwitches,
+                 PerfEventCount };
+
+/// The names of the events
+extern const char* const perfEventNames[PerfEventCount];
+
+/// Counter values, summed over threads
+struct PerfValues {
+   /// The counts, scaled up if the kernel multiplexed the group
+   double counts[PerfEventCount] = {};
+   /// Was the event counted?
+   bool available[PerfEventCount] = {};
+
+   /// Add the values of another measurement
+   void merge(const PerfValues& other) {
+      for (unsigned index = 0; index != PerfEventCount; ++index) {
+         counts[index] += other.counts[index];
+         available[index] |= other.available[index];
+      }
+   }
+};
+
+/// A group of counters for the calling thread
+class PerfCounters {
+   /// The file descriptors, -1 if the event is not available
+   int fds[PerfEventCount];
+   /// The events in the order of the group
+   unsigned order[PerfEventCount];
+   /// The number of events in the group
+   unsigned opened = 0;
+
+   public:
+   /// Open the group. The counters are stopped initially
+   PerfCounters();
+   /// Destructor
+   ~PerfCounters();
+
+   PerfCounters(const PerfCounters&) = delete;
+   PerfCounters& operator=(const PerfCounters&) = delete;
+
+   /// Is any event available?
+   bool valid() const { return opened; }
+   /// Reset and start the counters
+   void start();
+   /// Stop the counters and add their values
+   void stop(PerfValues& values);
+};
+
+#endif
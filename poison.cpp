@@ -0,0 +1,47 @@
+#include <cmath>
+#include <span>
+
+// Data-flow error handling. Invalid inputs produce poison values that propagate through the computation, and
+// the result is checked once at the end instead of after every step. In the sqrt computation, the square root of
+// a negative value is NaN, which is sticky. In the fib computation, errors produce a sentinel that saturating
+// additions keep intact. Without errno, sqrt compiles to plain sqrtsd/sqrtpd, which allows for vectorizing.
+
+/// Compute the square roots. Returns true if any result is NaN, i.e., if there was an invalid value
+static bool doSqrt(std::span<double> values) noexcept __attribute__((noinline));
+static bool doSqrt(std::span<double> values) noexcept {
+   bool poisoned = false;
+   for (auto& v : values) {
+      v = sqrt(v);
+      poisoned |= std::isnan(v);
+   }
+   return poisoned;
+}
+
+unsigned poisonSqrt(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      if (doSqrt(values)) ++failures;
+   }
+   return failures;
+}
+
+/// The error sentinel
+static constexpr unsigned poison = ~0u;
+
+/// Add, saturating at the sentinel. As all fib values are positive, a sentinel operand always saturates
+static unsigned saturatingAdd(unsigned a, unsigned b) noexcept {
+   unsigned result;
+   return __builtin_add_overflow(a, b, &result) ? poison : result;
+}
+
+static unsigned doFib(unsigned n, unsigned maxDepth) noexcept __attribute((noinline, optimize("no-optimize-sibling-calls")));
+static unsigned doFib(unsigned n, unsigned maxDepth) noexcept {
+   if (!maxDepth) return poison;
+   if (n <= 2) return 1;
+   return saturatingAdd(doFib(n - 2, maxDepth - 1), doFib(n - 1, maxDepth - 1));
+}
+
+unsigned poisonFib(unsigned n, unsigned maxDepth) noexcept {
+   auto v = doFib(n, maxDepth);
+   return (v == poison) ? 0 : v;
+}
@@ -0,0 +1,72 @@
+#include "simdsqrt.hpp"
+#include <cmath>
+#include <cstddef>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+// Vectorized sqrt kernels for the sqrt scenario. Instead of branching on every value, the kernels accumulate a
+// mask of negative values and report the error once for the whole span. The mechanisms then raise their error
+// based on that result, which separates the cost of the error handling from the cost of lost vectorization
+
+/// The scalar version
+static bool sqrtScalar(double* values, size_t count) noexcept {
+   bool negative = false;
+   for (size_t index = 0; index != count; ++index) {
+      double v = values[index];
+      negative |= (v < 0);
+      values[index] = (v < 0) ? v : sqrt(v);
+   }
+   return !negative;
+}
+
+#if defined(__x86_64__)
+
+/// The AVX2 version
+__attribute__((target("avx2"))) static bool sqrtAVX2(double* values, size_t count) noexcept {
+   __m256d zero = _mm256_setzero_pd(), negative = zero;
+   size_t index = 0;
+   for (; index + 4 <= count; index += 4) {
+      __m256d v = _mm256_loadu_pd(values + index);
+      __m256d mask = _mm256_cmp_pd(v, zero, _CMP_LT_OQ);
+      negative = _mm256_or_pd(negative, mask);
+      _mm256_storeu_pd(values + index, _mm256_blendv_pd(_mm256_sqrt_pd(v), v, mask));
+   }
+   bool valid = _mm256_testz_pd(negative, negative);
+   return sqrtScalar(values + index, count - index) && valid;
+}
+
+/// The SSE4.1 version
+__attribute__((target("sse4.1"))) static bool sqrtSSE4(double* values, size_t count) noexcept {
+   __m128d zero = _mm_setzero_pd(), negative = zero;
+   size_t index = 0;
+   for (; index + 2 <= count; index += 2) {
+      __m128d v = _mm_loadu_pd(values + index);
+      __m128d mask = _mm_cmplt_pd(v, zero);
+      negative = _mm_or_pd(negative, mask);
+      _mm_storeu_pd(values + index, _mm_blendv_pd(_mm_sqrt_pd(v), v, mask));
+   }
+   bool valid = !_mm_movemask_pd(negative);
+   return sqrtScalar(values + index, count - index) && valid;
+}
+
+/// Choose the kernel for the current CPU
+static bool (*chooseKernel())(double*, size_t) noexcept {
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2")) return sqrtAVX2;
+   if (__builtin_cpu_supports("sse4.1")) return sqrtSSE4;
+   return sqrtScalar;
+}
+
+#else
+#warning No vectorized sqrt kernel provided for this platform, falling back to scalar code
+
+static bool (*chooseKernel())(double*, size_t) noexcept { return sqrtScalar; }
+#endif
+
+/// The kernel used
+static bool (*const kernel)(double*, size_t) noexcept = chooseKernel();
+
+bool simdSqrt(std::span<double> values) noexcept {
+   return kernel(values.data(), values.size());
+}
@@ -0,0 +1,10 @@
+#ifndef H_simdsqrt
+#define H_simdsqrt
+
+#include <span>
+
+/// Compute the square roots of all non-negative values, leaving negative values untouched. Uses the widest vector
+/// instructions the CPU supports. Returns false if there was a negative value
+bool simdSqrt(std::span<double> values) noexcept;
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef H_sizedvalue
+#define H_sizedvalue
+
+#include <bit>
+#include <cstdint>
+
+// Values of different sizes for measuring the cost of returning larger results.
+// The fib computation only uses the first member, the rest is carried along
+
+/// A value with a given size in bytes
+template <unsigned size>
+struct SizedValue {
+   /// The value
+   unsigned value;
+   /// The padding
+   unsigned padding[size / sizeof(unsigned) - 1];
+};
+template <>
+struct SizedValue<4> {
+   /// The value
+   unsigned value;
+};
+
+/// Construct a sized value. Values that are returned in registers are assembled from whole 64 bit words. Storing
+/// the 4 byte value into a zeroed object would make the compiler reload it with wider loads for the return, which
+/// stalls on store forwarding. Larger values are returned in memory and are constructed in place
+template <class T>
+__attribute__((always_inline)) inline T makeSizedValue(unsigned value) {
+   if constexpr (sizeof(T) == sizeof(unsigned)) {
+      return std::bit_cast<T>(value);
+   } else if constexpr (sizeof(T) <= 2 * sizeof(uint64_t)) {
+      struct Words {
+         uint64_t w[sizeof(T) / sizeof(uint64_t)];
+      } words{};
+      words.w[0] = (std::endian::native == std::endian::little) ? uint64_t(value) : (uint64_t(value) << 32);
+      return std::bit_cast<T>(words);
+   } else {
+      T result{};
+      result.value = value;
+      return result;
+   }
+}
+
+/// Call f.operator()<size>() for a supported size. Returns 0 for unsupported sizes
+template <class F>
+unsigned dispatchResultSize(unsigned size, F&& f) {
+   switch (size) {
+      case 4: return f.template operator()<4>();
+      case 8: return f.template operator()<8>();
+      case 16: return f.template operator()<16>();
+      case 32: return f.template operator()<32>();
+      case 64: return f.template operator()<64>();
+      default: return 0;
+   }
+}
+
+#endif
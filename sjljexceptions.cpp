@@ -0,0 +1,95 @@
+#include <cmath>
+#include <cstdlib>
+#include <span>
+
+// Exceptions implemented like setjmp/longjmp based unwinders do it. Every try block pushes a handler record with
+// the saved register context onto a per-thread stack, and a throw jumps directly to the top-most handler without
+// consulting any unwind tables. The price is paid on the happy path, every try block has to save and
+// restore the context. Note that no destructors are run when jumping, which is fine for the code below.
+
+struct InvalidValue {};
+
+namespace {
+
+/// A handler record, lives in the stack frame of the try block
+struct Handler {
+   /// The enclosing handler
+   Handler* previous;
+   /// The register context, as needed by __builtin_setjmp
+   void* context[5];
+};
+
+/// The innermost handler of the current thread
+static thread_local Handler* handlerStack;
+/// The type of the exception in flight
+static thread_local const void* thrownType;
+
+/// Identifies an exception type
+template <class T>
+constexpr char typeTag = 0;
+
+/// Jump to the innermost handler
+[[noreturn]] static void __attribute__((noinline)) raise(const void* type) {
+   Handler* handler = handlerStack;
+   if (!handler) abort();
+   thrownType = type;
+   handlerStack = handler->previous;
+   __builtin_longjmp(handler->context, 1);
+}
+
+}
+
+/// Throw an exception
+#define SJLJ_THROW(T) raise(&typeTag<T>)
+/// Start a try block
+#define SJLJ_TRY                              \
+   {                                          \
+      Handler sjljHandler;                    \
+      sjljHandler.previous = handlerStack;    \
+      handlerStack = &sjljHandler;            \
+      if (!__builtin_setjmp(sjljHandler.context)) {
+/// End the try block and start the handler for T, other exceptions are propagated
+#define SJLJ_CATCH(T)                         \
+   handlerStack = sjljHandler.previous;       \
+   }                                          \
+   else if (thrownType != &typeTag<T>) raise(thrownType); \
+   else
+/// End the handler
+#define SJLJ_END }
+
+static void doSqrt(std::span<double> values) __attribute__((noinline));
+static void doSqrt(std::span<double> values) {
+   for (auto& v : values) {
+      if (v < 0) SJLJ_THROW(InvalidValue);
+      v = sqrt(v);
+   }
+}
+
+unsigned sjljExceptionsSqrt(std::span<double> values, unsigned repeat) {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      SJLJ_TRY
+         doSqrt(values);
+      SJLJ_CATCH(InvalidValue) { ++failures; }
+      SJLJ_END
+   }
+   return failures;
+}
+
+// prevent the compile from recognizing and compiling away the fib logic
+static unsigned doFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("-O1")));
+
+static unsigned doFib(unsigned n, unsigned maxDepth) {
+   if (!maxDepth) SJLJ_THROW(InvalidValue);
+   if (n <= 2) return 1;
+   return doFib(n - 2, maxDepth - 1) + doFib(n - 1, maxDepth - 1);
+}
+
+unsigned sjljExceptionsFib(unsigned n, unsigned maxDepth) {
+   unsigned result = 0;
+   SJLJ_TRY
+      result = doFib(n, maxDepth);
+   SJLJ_CATCH(InvalidValue) { result = 0; }
+   SJLJ_END
+   return result;
+}
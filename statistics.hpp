@@ -0,0 +1,71 @@
+#ifndef H_statistics
+#define H_statistics
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Statistics over repeated measurements. The median and the median absolute deviation are robust against the
+// occasional outlier of a noisy machine, the bootstrap confidence interval shows how far the median can be trusted
+
+/// The summary of repeated measurements
+struct Summary {
+   /// The number of measurements
+   unsigned count = 0;
+   /// The median
+   double median = 0;
+   /// The median absolute deviation from the median
+   double mad = 0;
+   /// The 95% confidence interval of the median
+   double ciLow = 0, ciHigh = 0;
+   /// The coefficient of variation, i.e., standard deviation divided by mean
+   double cv = 0;
+};
+
+/// The median of some values. Reorders the values
+inline double median(std::vector<double>& values) {
+   if (values.empty()) return 0;
+   auto middle = values.begin() + values.size() / 2;
+   std::nth_element(values.begin(), middle, values.end());
+   if (values.size() & 1) return *middle;
+   return (*middle + *std::max_element(values.begin(), middle)) / 2;
+}
+
+/// The coefficient of variation of some values
+inline double coefficientOfVariation(const std::vector<double>& values) {
+   if (values.size() < 2) return 0;
+   double sum = 0, squares = 0;
+   for (double v : values) sum += v;
+   double mean = sum / static_cast<double>(values.size());
+   for (double v : values) squares += (v - mean) * (v - mean);
+   return mean ? std::sqrt(squares / static_cast<double>(values.size() - 1)) / mean : 0;
+}
+
+/// Summarize some values. The random number generator drives the bootstrap resampling
+template <class Random>
+Summary summarize(const std::vector<double>& values, Random& random) {
+   Summary result;
+   result.count = values.size();
+   if (values.empty()) return result;
+
+   std::vector<double> work = values;
+   result.median = median(work);
+   for (auto& v : work) v = std::abs(v - result.median);
+   result.mad = median(work);
+   result.cv = coefficientOfVariation(values);
+
+   // Resample with replacement and take the 2.5% and 97.5% quantiles of the medians of the samples
+   constexpr unsigned resamples = 1000;
+   std::vector<double> medians;
+   medians.reserve(resamples);
+   for (unsigned index = 0; index != resamples; ++index) {
+      for (auto& v : work) v = values[random() % values.size()];
+      medians.push_back(median(work));
+   }
+   std::sort(medians.begin(), medians.end());
+   result.ciLow = medians[resamples * 25 / 1000];
+   result.ciHigh = medians[resamples * 975 / 1000];
+   return result;
+}
+
+#endif
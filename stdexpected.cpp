@@ -0,0 +1,79 @@
+#include "sizedvalue.hpp"
+#include <cmath>
+#include <span>
+#if __has_include(<expected>)
+#include <expected>
+#endif
+
+// The same computations as in expected.cpp, but using the std::expected of the standard library. Requires C++23
+
+unsigned expectedSqrt(std::span<double> values, unsigned repeat) noexcept;
+unsigned expectedFib(unsigned n, unsigned maxDepth) noexcept;
+unsigned expectedSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept;
+
+#ifdef __cpp_lib_expected
+
+struct InvalidValue {};
+
+static std::expected<void, InvalidValue> doSqrt(std::span<double> values) __attribute__((noinline));
+static std::expected<void, InvalidValue> doSqrt(std::span<double> values) {
+   for (auto& v : values) {
+      if (v < 0) return std::unexpected<InvalidValue>(InvalidValue{});
+      v = sqrt(v);
+   }
+   return {};
+}
+
+unsigned stdExpectedSqrt(std::span<double> values, unsigned repeat) noexcept {
+   unsigned failures = 0;
+   for (unsigned index = 0; index != repeat; ++index) {
+      if (!doSqrt(values)) ++failures;
+   }
+   return failures;
+}
+
+static std::expected<unsigned, InvalidValue> doFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("no-optimize-sibling-calls")));
+static std::expected<unsigned, InvalidValue> doFib(unsigned n, unsigned maxDepth) {
+   if (!maxDepth) return std::unexpected<InvalidValue>(InvalidValue{});
+   if (n <= 2) return 1;
+   auto n2 = doFib(n - 2, maxDepth - 1);
+   if (!n2) return std::unexpected<InvalidValue>(n2.error());
+   auto n1 = doFib(n - 1, maxDepth - 1);
+   if (!n1) return std::unexpected<InvalidValue>(n1.error());
+   return *n2 + *n1;
+}
+
+unsigned stdExpectedFib(unsigned n, unsigned maxDepth) noexcept {
+   auto r = doFib(n, maxDepth);
+   if (!r) return 0;
+   return *r;
+}
+
+template <unsigned size>
+static std::expected<SizedValue<size>, InvalidValue> doSizedFib(unsigned n, unsigned maxDepth) __attribute((noinline, optimize("no-optimize-sibling-calls")));
+template <unsigned size>
+static std::expected<SizedValue<size>, InvalidValue> doSizedFib(unsigned n, unsigned maxDepth) {
+   if (!maxDepth) return std::unexpected<InvalidValue>(InvalidValue{});
+   if (n <= 2) return makeSizedValue<SizedValue<size>>(1);
+   auto n2 = doSizedFib<size>(n - 2, maxDepth - 1);
+   if (!n2) return std::unexpected<InvalidValue>(n2.error());
+   auto n1 = doSizedFib<size>(n - 1, maxDepth - 1);
+   if (!n1) return std::unexpected<InvalidValue>(n1.error());
+   return makeSizedValue<SizedValue<size>>(n2->value + n1->value);
+}
+
+unsigned stdExpectedSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept {
+   return dispatchResultSize(size, [&]<unsigned s>() -> unsigned {
+      auto r = doSizedFib<s>(n, maxDepth);
+      if (!r) return 0;
+      return r->value;
+   });
+}
+
+#else
+#warning std::expected is not available, falling back to the vendored implementation
+
+unsigned stdExpectedSqrt(std::span<double> values, unsigned repeat) noexcept { return expectedSqrt(values, repeat); }
+unsigned stdExpectedFib(unsigned n, unsigned maxDepth) noexcept { return expectedFib(n, maxDepth); }
+unsigned stdExpectedSizedFib(unsigned size, unsigned n, unsigned maxDepth) noexcept { return expectedSizedFib(size, n, maxDepth); }
+#endif
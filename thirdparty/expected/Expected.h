@@ -300,13 +300,15 @@ union storage<void, E> {
     ~storage() { }
 };
 
-template<class T, class E>
+// With register_layout, the flag starts the next register. This allows for returning value and flag in two
+// registers, without packing them into one register first.
+template<class T, class E, bool register_layout = false>
 struct constexpr_base {
     typedef T value_type;
     typedef E error_type;
     typedef unexpected<E> unexpected_type;
     constexpr_storage<value_type, error_type> s;
-    bool has;
+    alignas(register_layout ? sizeof(void*) : alignof(bool)) bool has;
     constexpr constexpr_base() : s(), has(true) { }
     constexpr constexpr_base(value_tag_t tag) : s(tag), has(true) { }
     constexpr constexpr_base(error_tag_t tag) : s(tag), has(false) { }
@@ -356,13 +358,13 @@ struct base {
     }
 };
 
-template<class E>
-struct constexpr_base<void, E> {
+template<class E, bool register_layout>
+struct constexpr_base<void, E, register_layout> {
     typedef void value_type;
     typedef E error_type;
     typedef unexpected<E> unexpected_type;
     constexpr_storage<value_type, error_type> s;
-    bool has;
+    alignas(register_layout ? sizeof(void*) : alignof(bool)) bool has;
     constexpr constexpr_base() : s(), has(true) { }
     constexpr constexpr_base(value_tag_t tag) : s(tag), has(true) { }
     constexpr constexpr_base(error_tag_t tag) : s(tag), has(false) { }
@@ -402,11 +404,19 @@ struct base<void, E> {
     }
 };
 
+// Trivially copyable values and errors that fit into one register are returned in two registers
+template<class T, class E>
+struct use_register_layout : std::integral_constant<bool,
+    (std::is_void<T>::value || std::is_trivially_copyable<T>::value)
+        && std::is_trivially_copyable<E>::value
+        && (sizeof(constexpr_storage<T, E>) <= sizeof(void*))> { };
+
 template<class T, class E>
 using base_select = typename std::conditional<
     ((std::is_void<T>::value || std::is_trivially_destructible<T>::value)
         && std::is_trivially_destructible<E>::value),
-    constexpr_base<typename std::remove_const<T>::type, typename std::remove_const<E>::type>,
+    constexpr_base<typename std::remove_const<T>::type, typename std::remove_const<E>::type,
+        use_register_layout<typename std::remove_const<T>::type, typename std::remove_const<E>::type>::value>,
     base<typename std::remove_const<T>::type, typename std::remove_const<E>::type>
 >::type;
 
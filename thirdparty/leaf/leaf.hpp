@@ -93,6 +93,10 @@
 #   define BOOST_LEAF_CFG_WIN32 0
 #endif
 
+#ifndef BOOST_LEAF_CFG_ID_BLOCK_SIZE
+#   define BOOST_LEAF_CFG_ID_BLOCK_SIZE 1
+#endif
+
 #ifndef BOOST_LEAF_CFG_GNUC_STMTEXPR
 #   ifdef __GNUC__
 #   	define BOOST_LEAF_CFG_GNUC_STMTEXPR 1
@@ -129,6 +133,10 @@
 #   error BOOST_LEAF_CFG_GNUC_STMTEXPR must be 0 or 1.
 #endif
 
+#if BOOST_LEAF_CFG_ID_BLOCK_SIZE<1
+#   error BOOST_LEAF_CFG_ID_BLOCK_SIZE must be at least 1.
+#endif
+
 ////////////////////////////////////////
 
 // Configure BOOST_LEAF_NO_EXCEPTIONS, unless already #defined
@@ -1709,6 +1717,10 @@ namespace leaf_detail
 {
     struct BOOST_LEAF_SYMBOL_VISIBLE tls_tag_unexpected_enabled_counter;
     struct BOOST_LEAF_SYMBOL_VISIBLE tls_tag_id_factory_current_id;
+#if BOOST_LEAF_CFG_ID_BLOCK_SIZE>1
+    struct BOOST_LEAF_SYMBOL_VISIBLE tls_tag_id_factory_block_next;
+    struct BOOST_LEAF_SYMBOL_VISIBLE tls_tag_id_factory_block_end;
+#endif
 
     struct inject_loc
     {
@@ -2027,12 +2039,30 @@ namespace leaf_detail
     {
         static atomic_unsigned_int counter;
 
+#if BOOST_LEAF_CFG_ID_BLOCK_SIZE>1
+        // Each thread reserves BOOST_LEAF_CFG_ID_BLOCK_SIZE ids at once, to avoid
+        // touching the shared counter for every new error.
+        BOOST_LEAF_CONSTEXPR static unsigned generate_next_id() noexcept
+        {
+            unsigned id = tls::read_uint32<tls_tag_id_factory_block_next>();
+            if( id == tls::read_uint32<tls_tag_id_factory_block_end>() )
+            {
+                unsigned last = (counter+=4*BOOST_LEAF_CFG_ID_BLOCK_SIZE);
+                id = last - 4*(BOOST_LEAF_CFG_ID_BLOCK_SIZE-1);
+                tls::write_uint32<tls_tag_id_factory_block_end>(last+4);
+            }
+            tls::write_uint32<tls_tag_id_factory_block_next>(id+4);
+            BOOST_LEAF_ASSERT((id&3)==1);
+            return id;
+        }
+#else
         BOOST_LEAF_CONSTEXPR static unsigned generate_next_id() noexcept
         {
             auto id = (counter+=4);
             BOOST_LEAF_ASSERT((id&3)==1);
             return id;
         }
+#endif
     };
 
     template <class T>
@@ -27,16 +27,92 @@
 // FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 // DEALINGS IN THE SOFTWARE.
 //---------------------------------------------------------------------------
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <new>
+#include <string>
 #include <system_error>
+#include <type_traits>
 #include <variant>
 //---------------------------------------------------------------------------
+/// Allows for passing a class with non-trivial destructor in registers, if the compiler supports it
+#if defined(__has_cpp_attribute)
+#if __has_cpp_attribute(clang::trivial_abi)
+#define TBV_TRIVIAL_ABI [[clang::trivial_abi]]
+#endif
+#endif
+#ifndef TBV_TRIVIAL_ABI
+#define TBV_TRIVIAL_ABI
+#endif
+//---------------------------------------------------------------------------
 namespace tbv {
 //---------------------------------------------------------------------------
+/// Can objects of the type be moved by copying their bytes and forgetting the source? Can be specialized by users
+template <class T> struct is_trivially_relocatable : std::is_trivially_copyable<T> {};
+template <class T> struct is_trivially_relocatable<std::unique_ptr<T>> : std::true_type {};
+template <class T> inline constexpr bool is_trivially_relocatable_v = is_trivially_relocatable<T>::value;
+//---------------------------------------------------------------------------
+/// Describes a bit pattern that never occurs in valid values of T, which can be used to mark errors. Specializations must provide
+///    static constexpr bool available = true;
+///    static T error() noexcept;                 // construct the error marker
+///    static bool is_error(const T&) noexcept;   // check for the error marker
+template <class T> struct niche_traits { static constexpr bool available = false; };
+//---------------------------------------------------------------------------
+/// An error domain identified by a small integer. An error of a domain is just the integer id and the
+/// error value, which makes creating and classifying it as cheap as comparing two integers. The name and
+/// the messages are only looked up when an error is converted into a std::error_code
+struct error_domain {
+   /// The id, unique and in [first_user_domain, max_domains). Id 1 is reserved for generic_domain, id 0 for unknown domains
+   unsigned id;
+   /// The name
+   const char* name;
+   /// Describe an error value. Optional
+   const char* (*message)(int value) noexcept = nullptr;
+   /// The std::error_category of the domain, if there is one. Optional
+   const std::error_category& (*category)() noexcept = nullptr;
+};
+//---------------------------------------------------------------------------
+/// The number of domain ids
+inline constexpr unsigned max_domains = 64;
+/// The first id available for user domains
+inline constexpr unsigned first_user_domain = 2;
+//---------------------------------------------------------------------------
+/// The generic domain, i.e., errno values
+inline constexpr error_domain generic_domain{1, "generic", [](int value) noexcept -> const char* { return strerror(value); }, &std::generic_category};
+//---------------------------------------------------------------------------
 namespace detail {
 //---------------------------------------------------------------------------
+/// The registered domains
+inline std::atomic<const error_domain*> domains[max_domains] = {nullptr, &generic_domain};
+//---------------------------------------------------------------------------
+/// The category of errors of domains that have no std::error_category of their own. There is one object per domain
+class DomainCategory : public std::error_category {
+   public:
+   /// The domain id
+   inline unsigned id() const noexcept;
+   /// The name
+   const char* name() const noexcept override { auto d = domains[id()].load(std::memory_order_acquire); return d ? d->name : "unknown"; }
+   /// The message
+   std::string message(int value) const override { auto d = domains[id()].load(std::memory_order_acquire); if (d && d->message) return d->message(value); return std::string(name()) + " error " + std::to_string(value); }
+};
+//---------------------------------------------------------------------------
+/// The category objects of all domains
+inline const DomainCategory domainCategories[max_domains];
+//---------------------------------------------------------------------------
+unsigned DomainCategory::id() const noexcept { return this - domainCategories; }
+//---------------------------------------------------------------------------
 /// Do we have a tagged pointer?
 constexpr inline bool isErrorPointer(uintptr_t v) { return v&1; }
 //---------------------------------------------------------------------------
+/// Tag a domain id. Category pointers are aligned, thus domain tags have both low bits set while tagged pointers only have one
+constexpr inline uintptr_t tagDomain(unsigned id) { return (static_cast<uintptr_t>(id)<<2)|3; }
+//---------------------------------------------------------------------------
+/// Do we have a tagged domain id?
+constexpr inline bool isDomainTag(uintptr_t v) { return (v&3)==3; }
+//---------------------------------------------------------------------------
 /// Tag a pointer
 inline uintptr_t tagErrorPointer(const std::error_category& e) { return reinterpret_cast<uintptr_t>(&e)|1; }
 //---------------------------------------------------------------------------
@@ -46,12 +122,30 @@ inline const std::error_category& untagErrorPointer(uintptr_t v) { return *reint
 /// A helper struct for faster code in the error path. This help to avoid reconstructing the std::error_code for the inline cases
 struct errorresult { void* p1,*p2; };
 //---------------------------------------------------------------------------
+/// Get the category of a domain. Ids out of range map to the unknown domain
+inline const std::error_category& domainCategory(unsigned id) { if (id >= max_domains) [[unlikely]] id = 0; auto d = domains[id].load(std::memory_order_acquire); return (d && d->category) ? d->category() : domainCategories[id]; }
+//---------------------------------------------------------------------------
+/// Get the category of a tagged pointer or domain id
+inline const std::error_category& untagCategory(uintptr_t v) { return isDomainTag(v) ? domainCategory(v>>2) : untagErrorPointer(v); }
+//---------------------------------------------------------------------------
 /// Construct a std::error_code from an errorresult
-inline std::error_code convert(errorresult e) { union { void* p; int i; } u; u.p=e.p1; return std::error_code(u.i, untagErrorPointer(reinterpret_cast<uintptr_t>(e.p2))); }
+inline std::error_code convert(errorresult e) { union { void* p; int i; } u; u.p=e.p1; return std::error_code(u.i, untagCategory(reinterpret_cast<uintptr_t>(e.p2))); }
+//---------------------------------------------------------------------------
+/// Choose the layout of a result
+template <class T> constexpr int chooseMode() {
+   if constexpr (niche_traits<T>::available && std::is_trivially_copyable<T>::value) return 5;
+   else if constexpr (std::is_trivial<T>::value && (sizeof(T) <= sizeof(void*))) return 1;
+   else if constexpr (sizeof(T) <= sizeof(void*)) return is_trivially_relocatable_v<T> ? 3 : 2;
+   else if constexpr (std::is_trivially_copyable<T>::value && (sizeof(T) <= 2 * sizeof(void*))) return 4;
+   else return 0;
+}
+//---------------------------------------------------------------------------
+/// The error of results that store their error outside (mode 5). Only the most recent error of a thread is kept
+inline thread_local errorresult externalError;
 //---------------------------------------------------------------------------
 /// A result value that is either a value or an error_code. Will be specialized
 /// for various types to allow for a more efficient result passing
-template <class T, int mode = (std::is_trivial<T>::value && (sizeof(T) <= sizeof(void*))) ? 1 : (sizeof(T) <= sizeof(void*)) ? 2 : 0> class resultimpl
+template <class T, int mode = chooseMode<T>()> class resultimpl
 {
    private:
    using storage = std::variant<T, std::error_code>;
@@ -65,7 +159,7 @@ template <class T, int mode = (std::is_trivial<T>::value && (sizeof(T) <= sizeof
    /// Constructor
    resultimpl(std::error_code e) noexcept : content(e) {}
    /// Constructor
-   resultimpl(errorresult e) noexcept : content(e) {}
+   resultimpl(errorresult e) noexcept : content(std::in_place_index<1>, convert(e)) {}
    /// Copy constructor
    resultimpl(const resultimpl&) = default;
    /// Move constructor
@@ -133,7 +227,7 @@ template <class T> class resultimpl<T, 1> {
    /// Release the value
    T release() && noexcept { return c1.v; }
    /// Get the error code
-   std::error_code error() const noexcept { return std::error_code(c1.ev, untagErrorPointer(c2.v)); }
+   std::error_code error() const noexcept { return std::error_code(c1.ev, untagCategory(c2.v)); }
    /// Get the error code in the best format to return it
    constexpr errorresult error_return() const noexcept { return errorresult{c1.ptr1, c2.ptr2}; }
 };
@@ -159,12 +253,12 @@ template <class T> class resultimpl<T, 2> {
    /// Constructor
    constexpr resultimpl(errorresult e) noexcept : c1{e.p1}, c2{e.p2} {}
    /// Move constructor
-   resultimpl(resultimpl&& o) noexcept(noexcept(T(std::move(o.c1.v1)))) : c2{o.c2.ptr2} { if (o) new (c1.v) T(std::move(o.ref())); else c1.ptr1=o.c1.ptr1; }
+   resultimpl(resultimpl&& o) noexcept(noexcept(T(std::declval<T&&>()))) : c2{o.c2.ptr2} { if (o) new (c1.v) T(std::move(o.ref())); else c1.ptr1=o.c1.ptr1; }
    /// Destructor
    ~resultimpl() { if (has_value()) ref().T::~T(); }
 
    /// Assignment
-   resultimpl& operator=(resultimpl&& o) noexcept(noexcept(ref()=move(o.ref())) && noexcept(T(std::move(o.ref())))) { if (&o!=this) { if (o) { if (has_value()) ref()=std::move(o.ref()); else new (c1.v) T(std::move(o.ref())); } else { if (has_value()) ref().T::~T(); c1.ptr1=o.c1.ptr1; } c2.ptr2=o.c2.ptr2; } return *this; }
+   resultimpl& operator=(resultimpl&& o) noexcept(noexcept(std::declval<T&>()=std::declval<T&&>()) && noexcept(T(std::declval<T&&>()))) { if (&o!=this) { if (o) { if (has_value()) ref()=std::move(o.ref()); else new (c1.v) T(std::move(o.ref())); } else { if (has_value()) ref().T::~T(); c1.ptr1=o.c1.ptr1; } c2.ptr2=o.c2.ptr2; } return *this; }
 
    /// Do we have a value?
    explicit operator bool() const noexcept { return !isErrorPointer(c2.v); }
@@ -180,11 +274,143 @@ template <class T> class resultimpl<T, 2> {
    /// Release the value
    T release() noexcept(noexcept(T(std::move(ref())))) { return std::move(ref()); }
    /// Get the error code
-   std::error_code error() const noexcept { return std::error_code(c1.ev, untagErrorPointer(c2.v)); }
+   std::error_code error() const noexcept { return std::error_code(c1.ev, untagCategory(c2.v)); }
+   /// Get the error code in the best format to return it
+   constexpr errorresult error_return() const noexcept { return errorresult{c1.ptr1, c2.ptr2}; }
+};
+//---------------------------------------------------------------------------
+/// Helper class for trivially relocatable types that can be fit into one pointer. Moving just copies the
+/// bits, and with compiler support (TBV_TRIVIAL_ABI) the result is passed in two registers like in mode 1
+template <class T> class TBV_TRIVIAL_ABI resultimpl<T, 3> {
+   private:
+   /// The content, first half
+   union { void* ptr1; char v[sizeof(void*)]; int ev; } c1;
+   /// The content, second half. 0 for values, tagged pointer for errors, movedFrom after moving away
+   union { void* ptr2; uintptr_t v; } c2;
+
+   /// Marks a result whose value has been moved away
+   static constexpr uintptr_t movedFrom = 2;
+
+   /// Reference the object
+   const T& ref() const noexcept { return *std::launder(reinterpret_cast<const T*>(c1.v)); }
+   /// Reference the object
+   T& ref() noexcept { return *std::launder(reinterpret_cast<T*>(c1.v)); }
+
+   public:
+   /// Constructor
+   resultimpl(T v) noexcept(noexcept(T(std::move(v)))) : c2{nullptr} { new (c1.v) T(std::move(v)); }
+   /// Constructor
+   resultimpl(std::error_code e) noexcept : c1{.ev=e.value()}, c2{.v =tagErrorPointer(e.category())} {}
+   /// Constructor
+   constexpr resultimpl(errorresult e) noexcept : c1{e.p1}, c2{e.p2} {}
+   /// Move constructor. Relocates the value
+   resultimpl(resultimpl&& o) noexcept : c1{o.c1.ptr1}, c2{o.c2.ptr2} { if (!o.c2.v) o.c2.v=movedFrom; }
+   /// Destructor
+   ~resultimpl() { if (!c2.v) ref().T::~T(); }
+
+   /// Assignment
+   resultimpl& operator=(resultimpl&& o) noexcept { if (&o!=this) { if (!c2.v) ref().T::~T(); c1.ptr1=o.c1.ptr1; c2.ptr2=o.c2.ptr2; if (!o.c2.v) o.c2.v=movedFrom; } return *this; }
+
+   /// Do we have a value?
+   explicit operator bool() const noexcept { return !c2.v; }
+   /// Do we have a value?
+   bool has_value() const noexcept { return !c2.v; }
+   /// Do we have an error?
+   bool has_error() const noexcept { return isErrorPointer(c2.v); }
+
+   /// Get the value
+   const T& value() const noexcept { return ref(); }
+   /// Get the value
+   T& value() noexcept { return ref(); }
+   /// Release the value
+   T release() noexcept(noexcept(T(std::declval<T&&>()))) { return std::move(ref()); }
+   /// Get the error code
+   std::error_code error() const noexcept { return std::error_code(c1.ev, untagCategory(c2.v)); }
+   /// Get the error code in the best format to return it
+   constexpr errorresult error_return() const noexcept { return errorresult{c1.ptr1, c2.ptr2}; }
+};
+//---------------------------------------------------------------------------
+/// Helper class for trivially copyable types of up to two pointers. Avoids the index and the visitation of std::variant.
+/// Note that this is not smaller than the variant, for a 16 byte T both take 24 bytes
+template <class T> class resultimpl<T, 4> {
+   private:
+   /// The content, the value or the error value
+   union { T v; void* ptr1; int ev; } c1;
+   /// The error category, tagged, or nullptr for values
+   union { void* ptr2; uintptr_t v; } c2;
+
+   public:
+   /// Constructor
+   constexpr resultimpl(T v) noexcept : c1{.v=v}, c2{nullptr} {}
+   /// Constructor
+   resultimpl(std::error_code e) noexcept : c1{.ev=e.value()}, c2{.v =tagErrorPointer(e.category())} {}
+   /// Constructor
+   constexpr resultimpl(errorresult e) noexcept : c1{.ptr1=e.p1}, c2{e.p2} {}
+   /// Move constructor
+   resultimpl(resultimpl&&) = default;
+
+   /// Assignment
+   resultimpl& operator=(resultimpl&&) = default;
+
+   /// Do we have a value?
+   explicit operator bool() const noexcept { return !isErrorPointer(c2.v); }
+   /// Do we have a value?
+   bool has_value() const noexcept { return !isErrorPointer(c2.v); }
+   /// Do we have an error?
+   bool has_error() const noexcept { return isErrorPointer(c2.v); }
+
+   /// Get the value
+   const T& value() const noexcept { return c1.v; }
+   /// Get the value
+   T& value() noexcept { return c1.v; }
+   /// Release the value
+   T release() && noexcept { return c1.v; }
+   /// Get the error code
+   std::error_code error() const noexcept { return std::error_code(c1.ev, untagCategory(c2.v)); }
    /// Get the error code in the best format to return it
    constexpr errorresult error_return() const noexcept { return errorresult{c1.ptr1, c2.ptr2}; }
 };
 //---------------------------------------------------------------------------
+/// Helper class for trivially copyable types with a niche (see niche_traits). The result has the size of T,
+/// errors are marked by the niche and the error itself is kept in a thread local slot. Thus, the error of a
+/// result can only be examined until the next error is produced by the same thread
+template <class T> class resultimpl<T, 5> {
+   private:
+   /// The value or the error marker
+   T v;
+
+   public:
+   /// Constructor
+   constexpr resultimpl(T v) noexcept : v(v) {}
+   /// Constructor
+   resultimpl(std::error_code e) noexcept : v(niche_traits<T>::error()) { externalError = errorresult{reinterpret_cast<void*>(static_cast<uintptr_t>(e.value())), reinterpret_cast<void*>(tagErrorPointer(e.category()))}; }
+   /// Constructor
+   resultimpl(errorresult e) noexcept : v(niche_traits<T>::error()) { externalError = e; }
+   /// Move constructor
+   resultimpl(resultimpl&&) = default;
+
+   /// Assignment
+   resultimpl& operator=(resultimpl&&) = default;
+
+   /// Do we have a value?
+   explicit operator bool() const noexcept { return !niche_traits<T>::is_error(v); }
+   /// Do we have a value?
+   bool has_value() const noexcept { return !niche_traits<T>::is_error(v); }
+   /// Do we have an error?
+   bool has_error() const noexcept { return niche_traits<T>::is_error(v); }
+
+   /// Get the value
+   const T& value() const noexcept { return v; }
+   /// Get the value
+   T& value() noexcept { return v; }
+   /// Release the value
+   T release() && noexcept { return v; }
+   /// Get the error code
+   std::error_code error() const noexcept { return convert(externalError); }
+   /// Get the error code in the best format to return it
+   errorresult error_return() const noexcept { return externalError; }
+};
+//---------------------------------------------------------------------------
 }
 //---------------------------------------------------------------------------
 /// A result value that is either a value or an error_code. Will be specialized
@@ -193,6 +419,13 @@ template <class T> class [[nodiscard]] result : public detail::resultimpl<T>
 {
    public:
    using detail::resultimpl<T>::resultimpl;
+
+   /// Call f with the value, or propagate the error. f must return a result
+   template <class F> std::invoke_result_t<F, T> and_then(F&& f) && { if (this->has_error()) [[unlikely]] return this->error_return(); return std::forward<F>(f)(std::move(*this).release()); }
+   /// Apply f to the value, or propagate the error
+   template <class F> result<std::invoke_result_t<F, T>> transform(F&& f) && { if (this->has_error()) [[unlikely]] return this->error_return(); if constexpr (std::is_void_v<std::invoke_result_t<F, T>>) { std::forward<F>(f)(std::move(*this).release()); return {}; } else return std::forward<F>(f)(std::move(*this).release()); }
+   /// Call f with the error, or keep the value. f must return a result<T>
+   template <class F> result or_else(F&& f) && { if (this->has_error()) [[unlikely]] return std::forward<F>(f)(this->error()); return std::move(*this); }
 };
 //---------------------------------------------------------------------------
 /// A void result
@@ -226,14 +459,81 @@ template<> class [[nodiscard]] result<void> {
    constexpr void release() noexcept { }
 
    /// Get the error code
-   std::error_code error() const noexcept { return std::error_code(c1.ev, detail::untagErrorPointer(c2.v)); }
+   std::error_code error() const noexcept { return std::error_code(c1.ev, detail::untagCategory(c2.v)); }
    /// Get the error code in the best format to return it
    constexpr detail::errorresult error_return() const noexcept { return detail::errorresult{c1.ptr1, c2.ptr2}; }
+
+   /// Call f, or propagate the error. f must return a result
+   template <class F> std::invoke_result_t<F> and_then(F&& f) && { if (has_error()) [[unlikely]] return error_return(); return std::forward<F>(f)(); }
+   /// Call f, or propagate the error
+   template <class F> result<std::invoke_result_t<F>> transform(F&& f) && { if (has_error()) [[unlikely]] return error_return(); if constexpr (std::is_void_v<std::invoke_result_t<F>>) { std::forward<F>(f)(); return {}; } else return std::forward<F>(f)(); }
+   /// Call f with the error. f must return a result<void>
+   template <class F> result or_else(F&& f) && { if (has_error()) [[unlikely]] return std::forward<F>(f)(error()); return {}; }
+};
+//---------------------------------------------------------------------------
+/// The maximum number of values in a batch. Larger inputs have to be split into several batches
+inline constexpr uint32_t max_batch_size = std::numeric_limits<uint32_t>::max();
+//---------------------------------------------------------------------------
+/// The result of processing a batch of values. Either all values were processed, or processing stopped at the
+/// first failing value. The position of that value is kept next to the error value, which keeps the result in
+/// two registers. Thus, the position is 32 bit and batches are limited to max_batch_size values. The position is
+/// taken as uint32_t, callers that index with size_t have to narrow explicitly
+class [[nodiscard]] batch_result {
+   private:
+   /// The content, first half. The number of values, or the error value and the position of the failure
+   union { void* ptr1; uint64_t count; struct { int ev; uint32_t position; } e; } c1;
+   /// The content, second half
+   union { void* ptr2; uintptr_t v; } c2;
+
+   public:
+   /// Constructor. All values were processed
+   constexpr batch_result(uint64_t count) noexcept : c1{.count=count}, c2{nullptr} {}
+   /// Constructor. Processing failed at the given position
+   batch_result(uint32_t position, detail::errorresult e) noexcept : c1{.ptr1=e.p1}, c2{e.p2} { c1.e.position=position; }
+   /// Constructor. Processing failed at the given position
+   batch_result(uint32_t position, std::error_code e) noexcept : c1{.e={e.value(), position}}, c2{.v=detail::tagErrorPointer(e.category())} {}
+
+   /// Were all values processed?
+   explicit operator bool() const noexcept { return !detail::isErrorPointer(c2.v); }
+   /// Were all values processed?
+   bool has_value() const noexcept { return !detail::isErrorPointer(c2.v); }
+   /// Did processing fail?
+   bool has_error() const noexcept { return detail::isErrorPointer(c2.v); }
+   /// The number of values that were processed successfully. On failure, this is the position of the failing value
+   uint64_t processed() const noexcept { return has_error() ? c1.e.position : c1.count; }
+
+   /// Get the error code
+   std::error_code error() const noexcept { return std::error_code(c1.e.ev, detail::untagCategory(c2.v)); }
+   /// Get the error code in the best format to return it
+   detail::errorresult error_return() const noexcept { return detail::errorresult{reinterpret_cast<void*>(static_cast<uintptr_t>(static_cast<unsigned>(c1.e.ev))), c2.ptr2}; }
 };
 //---------------------------------------------------------------------------
 /// Helper to throw/return an error
 inline detail::errorresult throw_value [[nodiscard]] (std::error_code e) { return detail::errorresult{reinterpret_cast<void*>(static_cast<uintptr_t>(e.value())), reinterpret_cast<void*>(detail::tagErrorPointer(e.category()))}; }
 //---------------------------------------------------------------------------
+/// Helper to throw/return an error of an integer domain. The domain must be generic_domain or have a user domain id
+inline detail::errorresult throw_value [[nodiscard]] (const error_domain& d, int value) noexcept { assert(((d.id >= first_user_domain) && (d.id < max_domains)) || (&d == &generic_domain)); return detail::errorresult{reinterpret_cast<void*>(static_cast<uintptr_t>(value)), reinterpret_cast<void*>(detail::tagDomain(d.id))}; }
+//---------------------------------------------------------------------------
+/// Register a domain, which makes its name and messages available in std::error_code. Not needed for classifying errors.
+/// Fails for ids outside [first_user_domain, max_domains), and for ids that are taken by another domain. Safe to call
+/// while other threads convert errors, they see the domain once it is registered
+inline bool register_domain(const error_domain& d) noexcept {
+   if ((d.id < first_user_domain) || (d.id >= max_domains)) return false;
+   const error_domain* expected = nullptr;
+   return detail::domains[d.id].compare_exchange_strong(expected, &d, std::memory_order_release, std::memory_order_acquire) || (expected == &d);
+}
+//---------------------------------------------------------------------------
+/// Does a result hold the given error of an integer domain? Does not construct a std::error_code
+template <class R> bool error_is(const R& r, const error_domain& d, int value) noexcept {
+   if constexpr (std::is_same_v<decltype(r.error_return()), std::error_code>) {
+      return r.has_error() && (r.error() == std::error_code(value, detail::domainCategory(d.id)));
+   } else {
+      auto e = r.error_return();
+      union { void* p; int i; } u; u.p=e.p1;
+      return r.has_error() && (reinterpret_cast<uintptr_t>(e.p2) == detail::tagDomain(d.id)) && (u.i == value);
+   }
+}
+//---------------------------------------------------------------------------
 #ifndef TBV_NOMACROS
 // Convenience macros
 #define TRY(x) ({ auto _tbv_r = (x); if (_tbv_r.has_error()) [[unlikely]] return _tbv_r.error_return(); std::move(_tbv_r).release(); })
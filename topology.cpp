@@ -0,0 +1,111 @@
+#include "topology.hpp"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <thread>
+#include <utility>
+#ifdef __linux__
+#include <filesystem>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+#ifdef __linux__
+/// Read a number from a sysfs file. Returns the fallback if the file does not exist
+static unsigned readNumber(const string& path, unsigned fallback) {
+   ifstream in(path);
+   unsigned result;
+   if (!(in >> result)) return fallback;
+   return result;
+}
+
+/// Find the NUMA node of a CPU, which appears as nodeN entry in its directory
+static unsigned readNode(const string& path) {
+   error_code ec;
+   for (auto& e : filesystem::directory_iterator(path, ec)) {
+      auto name = e.path().filename().string();
+      if ((name.size() > 4) && (name.compare(0, 4, "node") == 0) && (name.find_first_not_of("0123456789", 4) == string::npos))
+         return stoul(name.substr(4));
+   }
+   return 0;
+}
+#endif
+
+Topology Topology::read() {
+   Topology result;
+#ifdef __linux__
+   cpu_set_t allowed;
+   if (!sched_getaffinity(0, sizeof(allowed), &allowed)) {
+      map<pair<unsigned, unsigned>, unsigned> cores;
+      for (unsigned id = 0; id != CPU_SETSIZE; ++id) {
+         if (!CPU_ISSET(id, &allowed)) continue;
+         string path = "/sys/devices/system/cpu/cpu" + to_string(id);
+         unsigned package = readNumber(path + "/topology/physical_package_id", 0);
+         unsigned coreId = readNumber(path + "/topology/core_id", id);
+         auto core = cores.emplace(pair(package, coreId), cores.size()).first->second;
+         result.cpus.push_back({id, core, package, readNode(path)});
+      }
+   }
+#endif
+   if (result.cpus.empty()) {
+      unsigned count = max(thread::hardware_concurrency(), 1u);
+      for (unsigned id = 0; id != count; ++id) result.cpus.push_back({id, id, 0, 0});
+   }
+   return result;
+}
+
+unsigned Topology::coreCount() const {
+   unsigned result = 0;
+   for (auto& c : cpus) result = max(result, c.core + 1);
+   return result;
+}
+
+unsigned Topology::nodeCount() const {
+   vector<unsigned> nodes;
+   for (auto& c : cpus)
+      if (find(nodes.begin(), nodes.end(), c.node) == nodes.end()) nodes.push_back(c.node);
+   return nodes.size();
+}
+
+const vector<string_view>& Topology::policies() {
+   static const vector<string_view> policies{"cores", "smt", "spread", "node"};
+   return policies;
+}
+
+vector<unsigned> Topology::place(string_view policy) const {
+   // The first CPU of every core, in the order of the CPU numbers
+   vector<const Cpu*> firstOfCore(coreCount(), nullptr);
+   for (auto& c : cpus)
+      if (!firstOfCore[c.core]) firstOfCore[c.core] = &c;
+
+   vector<unsigned> result;
+   if (policy == "cores") {
+      // One thread per physical core
+      for (auto c : firstOfCore) result.push_back(c->id);
+   } else if (policy == "smt") {
+      // Fill all hardware threads of a core before moving to the next core
+      for (auto c : firstOfCore)
+         for (auto& s : cpus)
+            if (s.core == c->core) result.push_back(s.id);
+   } else if (policy == "spread") {
+      // One thread per physical core, alternating between the NUMA nodes
+      map<unsigned, vector<unsigned>> byNode;
+      for (auto c : firstOfCore) byNode[c->node].push_back(c->id);
+      for (unsigned index = 0; result.size() != firstOfCore.size(); ++index)
+         for (auto& n : byNode)
+            if (index < n.second.size()) result.push_back(n.second[index]);
+   } else if (policy == "node") {
+      // One thread per physical core of the first NUMA node
+      for (auto c : firstOfCore)
+         if (c->node == cpus.front().node) result.push_back(c->id);
+   }
+   return result;
+}
+
+vector<unsigned> Topology::defaultPlacement() const {
+   auto result = place("cores");
+   for (auto& c : cpus)
+      if (find(result.begin(), result.end(), c.id) == result.end()) result.push_back(c.id);
+   return result;
+}
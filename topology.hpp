@@ -0,0 +1,46 @@
+#ifndef H_topology
+#define H_topology
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The CPU topology, read from /sys/devices/system/cpu, and the thread placements derived from it. A placement is
+// the list of CPUs that the workers are pinned to, worker n runs on the n-th CPU of the list
+
+/// A logical CPU
+struct Cpu {
+   /// The CPU number
+   unsigned id;
+   /// The physical core, unique across packages
+   unsigned core;
+   /// The package (socket)
+   unsigned package;
+   /// The NUMA node
+   unsigned node;
+};
+
+/// The CPUs the process may run on
+class Topology {
+   /// The CPUs, ordered by number
+   std::vector<Cpu> cpus;
+
+   public:
+   /// Read the topology. Without topology information, every CPU is its own core on node 0
+   static Topology read();
+
+   /// The number of physical cores
+   unsigned coreCount() const;
+   /// The number of NUMA nodes
+   unsigned nodeCount() const;
+
+   /// The placement policies
+   static const std::vector<std::string_view>& policies();
+   /// The CPUs of a placement policy, empty if the policy is unknown
+   std::vector<unsigned> place(std::string_view policy) const;
+   /// The placement without a specific policy. One thread per physical core as in cores, followed by the remaining
+   /// hardware threads for thread counts beyond the number of cores
+   std::vector<unsigned> defaultPlacement() const;
+};
+
+#endif
@@ -0,0 +1,298 @@
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include <link.h>
+#include <pthread.h>
+#include <unwind.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Instrumentation for the unwinder, meant to be preloaded into the benchmark:
+//   LD_PRELOAD=bin/libunwindstats.so bin/runtests exceptions
+// Wraps the entry points involved in a throw and measures the time spent in them, including the time spent
+// waiting on mutexes inside _Unwind_Find_FDE. Counters are kept per thread and summed up per phase of the
+// benchmark, which bin/runtests announces through unwindStatsPhase. The breakdown is printed when the process exits.
+// Note that bin/runtests provides its own _Unwind_Find_FDE (see fdelookup.cpp). Without --lockfree and --fdecache it
+// forwards every lookup, with them we only see the lookups that the tree or the cache cannot answer.
+
+namespace {
+
+/// The counters that we maintain
+enum Counter { Throws,
+               ThrowCycles,
+               RaiseCalls,
+               ResumeCalls,
+               FindFDECalls,
+               FindFDECycles,
+               MutexWaits,
+               MutexWaitCycles,
+               IteratePhdrCalls,
+               IteratePhdrCycles,
+               IteratePhdrCallbackCycles,
+               FindObjectCalls,
+               FindObjectCycles,
+               CounterCount };
+
+/// A cycle-accurate timer
+static inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   return std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+/// The counters of one thread
+struct ThreadCounters {
+   /// The counter values
+   uint64_t values[CounterCount];
+   /// The start of the currently active throw, if any
+   uint64_t throwStart;
+   /// Are we currently inside _Unwind_Find_FDE?
+   bool inFindFDE;
+};
+
+/// The counters of all threads and the finished phases
+class Registry {
+   /// The counters of all threads that ever threw. Blocks of exited threads are reused
+   std::vector<ThreadCounters*> threads, unused;
+   /// The finished phases
+   std::vector<std::pair<std::string, std::vector<uint64_t>>> phases;
+   /// The name of the current phase
+   std::string currentPhase = "total";
+   /// Protects everything
+   std::mutex mutex;
+
+   /// Move the counters of all threads into the current phase. Requires the mutex
+   void flush();
+
+   public:
+   /// Get a counter block for a new thread
+   ThreadCounters* acquire();
+   /// Release the counter block of an exiting thread
+   void release(ThreadCounters* counters);
+   /// Start a new phase
+   void startPhase(const char* name);
+   /// Print all statistics
+   void print();
+};
+
+void Registry::flush() {
+   std::vector<uint64_t> sum(CounterCount);
+   for (auto t : threads)
+      for (unsigned index = 0; index != CounterCount; ++index) {
+         sum[index] += t->values[index];
+         t->values[index] = 0;
+      }
+   if (sum[Throws]) phases.emplace_back(currentPhase, std::move(sum));
+}
+
+ThreadCounters* Registry::acquire() {
+   std::unique_lock lock(mutex);
+   if (!unused.empty()) {
+      auto result = unused.back();
+      unused.pop_back();
+      return result;
+   }
+   threads.push_back(new ThreadCounters{});
+   return threads.back();
+}
+
+void Registry::release(ThreadCounters* counters) {
+   // The counters remain registered until the next flush
+   std::unique_lock lock(mutex);
+   counters->throwStart = 0;
+   counters->inFindFDE = false;
+   unused.push_back(counters);
+}
+
+void Registry::startPhase(const char* name) {
+   std::unique_lock lock(mutex);
+   flush();
+   currentPhase = name;
+}
+
+void Registry::print() {
+   std::unique_lock lock(mutex);
+   flush();
+   if (phases.empty()) return;
+
+   auto perThrow = [](const std::vector<uint64_t>& c, Counter counter) { return static_cast<double>(c[counter]) / static_cast<double>(c[Throws]); };
+   auto share = [](const std::vector<uint64_t>& c, uint64_t cycles) { return c[ThrowCycles] ? (100.0 * static_cast<double>(cycles) / static_cast<double>(c[ThrowCycles])) : 0.0; };
+   fprintf(stderr, "\nunwinder statistics, calls and cycles per throw, share of the total throw time\n");
+   for (auto& [name, c] : phases) {
+      uint64_t iterateExclusive = c[IteratePhdrCycles] - std::min(c[IteratePhdrCycles], c[IteratePhdrCallbackCycles]);
+      fprintf(stderr, "%s: %lu throws, %.0f cycles/throw | _Unwind_RaiseException %.1f | _Unwind_Resume %.1f | _Unwind_Find_FDE %.1f, %.0f cycles, %.1f%% | mutex wait %.1f, %.0f cycles, %.1f%% | dl_iterate_phdr %.1f, %.0f cycles without callbacks, %.1f%% | _dl_find_object %.1f, %.0f cycles, %.1f%%\n",
+              name.c_str(), static_cast<unsigned long>(c[Throws]), perThrow(c, ThrowCycles),
+              perThrow(c, RaiseCalls), perThrow(c, ResumeCalls),
+              perThrow(c, FindFDECalls), perThrow(c, FindFDECycles), share(c, c[FindFDECycles]),
+              perThrow(c, MutexWaits), perThrow(c, MutexWaitCycles), share(c, c[MutexWaitCycles]),
+              perThrow(c, IteratePhdrCalls), static_cast<double>(iterateExclusive) / static_cast<double>(c[Throws]), share(c, iterateExclusive),
+              perThrow(c, FindObjectCalls), perThrow(c, FindObjectCycles), share(c, c[FindObjectCycles]));
+   }
+}
+
+/// The registry. Intentionally leaked, it must outlive all threads. Null until the library is initialized
+static Registry* registry;
+
+/// Releases the counters when the thread exits
+struct ThreadCountersHandle {
+   ThreadCounters* counters = nullptr;
+   ~ThreadCountersHandle() {
+      if (counters) registry->release(counters);
+   }
+};
+static thread_local ThreadCountersHandle threadCounters;
+
+/// Collects the counters before the library is initialized, they are never reported
+static ThreadCounters ignoredCounters;
+
+/// Get the counters of the current thread
+static ThreadCounters& counters() {
+   auto& handle = threadCounters;
+   if (!handle.counters) {
+      if (!registry) return ignoredCounters;
+      handle.counters = registry->acquire();
+   }
+   return *handle.counters;
+}
+
+/// Resolve the next definition of a function
+template <class T>
+static T next(T& slot, const char* name) {
+   if (!slot) slot = reinterpret_cast<T>(dlsym(RTLD_NEXT, name));
+   return slot;
+}
+
+/// The wrapped functions
+static void (*originalThrow)(void*, void*, void (*)(void*));
+static void* (*originalBeginCatch)(void*);
+static _Unwind_Reason_Code (*originalRaiseException)(_Unwind_Exception*);
+static void (*originalResume)(_Unwind_Exception*);
+static const void* (*originalFindFDE)(void*, void*);
+static int (*originalMutexLock)(pthread_mutex_t*);
+static int (*originalIteratePhdr)(int (*)(dl_phdr_info*, size_t, void*), void*);
+#ifdef DLFO_STRUCT_HAS_EH_DBASE
+static int (*originalFindObject)(void*, dl_find_object*);
+#endif
+
+/// Start the timer of a throw if it is not running yet
+static void startThrow(ThreadCounters& c) {
+   if (!c.throwStart) {
+      ++c.values[Throws];
+      c.throwStart = now();
+   }
+}
+
+/// The state of a wrapped dl_iterate_phdr callback
+struct IterateState {
+   int (*callback)(dl_phdr_info*, size_t, void*);
+   void* data;
+   uint64_t cycles;
+};
+
+/// Measure the time spent in a dl_iterate_phdr callback
+static int timedCallback(dl_phdr_info* info, size_t size, void* data) {
+   auto state = static_cast<IterateState*>(data);
+   uint64_t start = now();
+   int result = state->callback(info, size, state->data);
+   state->cycles += now() - start;
+   return result;
+}
+
+}
+
+extern "C" {
+
+/// Announce a new phase of the benchmark
+void unwindStatsPhase(const char* name) {
+   if (registry) registry->startPhase(name);
+}
+
+[[noreturn]] void __cxa_throw(void* object, void* type, void (*destructor)(void*)) {
+   auto& c = counters();
+   c.throwStart = 0;
+   startThrow(c);
+   next(originalThrow, "__cxa_throw")(object, type, destructor);
+   __builtin_unreachable();
+}
+
+void* __cxa_begin_catch(void* exception) noexcept {
+   auto& c = counters();
+   if (c.throwStart) {
+      c.values[ThrowCycles] += now() - c.throwStart;
+      c.throwStart = 0;
+   }
+   return next(originalBeginCatch, "__cxa_begin_catch")(exception);
+}
+
+_Unwind_Reason_Code _Unwind_RaiseException(_Unwind_Exception* exception) {
+   auto& c = counters();
+   ++c.values[RaiseCalls];
+   startThrow(c);
+   return next(originalRaiseException, "_Unwind_RaiseException")(exception);
+}
+
+void _Unwind_Resume(_Unwind_Exception* exception) {
+   // Outside of a throw, this is a throw that skips the search phase (see memoizedexceptions.cpp)
+   auto& c = counters();
+   ++c.values[ResumeCalls];
+   startThrow(c);
+   next(originalResume, "_Unwind_Resume")(exception);
+   __builtin_unreachable();
+}
+
+const void* _Unwind_Find_FDE(void* pc, void* bases) {
+   auto& c = counters();
+   ++c.values[FindFDECalls];
+   c.inFindFDE = true;
+   uint64_t start = now();
+   auto result = next(originalFindFDE, "_Unwind_Find_FDE")(pc, bases);
+   c.values[FindFDECycles] += now() - start;
+   c.inFindFDE = false;
+   return result;
+}
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) noexcept {
+   auto lock = next(originalMutexLock, "pthread_mutex_lock");
+   if (!threadCounters.counters || !threadCounters.counters->inFindFDE) return lock(mutex);
+   auto& c = *threadCounters.counters;
+   uint64_t start = now();
+   int result = lock(mutex);
+   ++c.values[MutexWaits];
+   c.values[MutexWaitCycles] += now() - start;
+   return result;
+}
+
+int dl_iterate_phdr(int (*callback)(dl_phdr_info*, size_t, void*), void* data) noexcept {
+   auto& c = counters();
+   IterateState state{callback, data, 0};
+   uint64_t start = now();
+   int result = next(originalIteratePhdr, "dl_iterate_phdr")(timedCallback, &state);
+   ++c.values[IteratePhdrCalls];
+   c.values[IteratePhdrCycles] += now() - start;
+   c.values[IteratePhdrCallbackCycles] += state.cycles;
+   return result;
+}
+
+#ifdef DLFO_STRUCT_HAS_EH_DBASE
+int _dl_find_object(void* address, dl_find_object* result) noexcept {
+   auto& c = counters();
+   uint64_t start = now();
+   int found = next(originalFindObject, "_dl_find_object")(address, result);
+   ++c.values[FindObjectCalls];
+   c.values[FindObjectCycles] += now() - start;
+   return found;
+}
+#endif
+}
+
+/// Create the registry
+static void __attribute__((constructor)) initUnwindStats() { registry = new Registry(); }
+/// Print the statistics at exit
+static void __attribute__((destructor)) printUnwindStats() { registry->print(); }
@@ -0,0 +1,127 @@
+#include "workerpool.hpp"
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+void SpinBarrier::wait() {
+   unsigned current = generation.load();
+   if (arrived.fetch_add(1) + 1 == count) {
+      arrived.store(0);
+      generation.fetch_add(1);
+      return;
+   }
+   // Yield after a while, in case there are more threads than cores
+   for (unsigned spins = 0; generation.load() == current; ++spins) {
+      if (spins >= 100000) {
+         std::this_thread::yield();
+         continue;
+      }
+#if defined(__x86_64__) || defined(__i386__)
+      __builtin_ia32_pause();
+#endif
+   }
+}
+
+/// Pin the calling thread to a CPU
+static void pinThread([[maybe_unused]] unsigned cpu) {
+#ifdef __linux__
+   cpu_set_t set;
+   CPU_ZERO(&set);
+   CPU_SET(cpu, &set);
+   pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+WorkerPool::WorkerPool() {
+#ifdef __linux__
+   cpu_set_t allowed;
+   if (!sched_getaffinity(0, sizeof(allowed), &allowed))
+      for (unsigned cpu = 0; cpu != CPU_SETSIZE; ++cpu)
+         if (CPU_ISSET(cpu, &allowed)) defaultPlacement.push_back(cpu);
+#endif
+   placement = defaultPlacement;
+}
+
+void WorkerPool::setPlacement(std::vector<unsigned> cpus) {
+   std::unique_lock lock(mutex);
+   placement = cpus.empty() ? defaultPlacement : std::move(cpus);
+   ++placementNumber;
+}
+
+void WorkerPool::setDefaultPlacement(std::vector<unsigned> cpus) {
+   std::unique_lock lock(mutex);
+   defaultPlacement = std::move(cpus);
+   placement = defaultPlacement;
+   ++placementNumber;
+}
+
+void WorkerPool::workerMain(unsigned id) {
+   unsigned seen = 0, pinned = ~0u;
+   while (true) {
+      {
+         std::unique_lock lock(mutex);
+         jobStarted.wait(lock, [&] { return done || ((jobNumber != seen) && (id < active)); });
+         if (done) return;
+         seen = jobNumber;
+         if ((pinned != placementNumber) && !placement.empty()) pinThread(placement[id % placement.size()]);
+         pinned = placementNumber;
+      }
+
+      // Start all workers together
+      auto& w = *workers[id];
+      barrier.wait();
+      w.start = std::chrono::steady_clock::now();
+      job(id);
+      w.stop = std::chrono::steady_clock::now();
+
+      std::unique_lock lock(mutex);
+      if (!--running) jobFinished.notify_one();
+   }
+}
+
+WorkerPool::~WorkerPool() {
+   {
+      std::unique_lock lock(mutex);
+      done = true;
+   }
+   jobStarted.notify_all();
+   for (auto w : workers) {
+      w->thread.join();
+      delete w;
+   }
+}
+
+std::chrono::nanoseconds WorkerPool::run(unsigned threadCount, std::function<void(unsigned)> newJob) {
+   if (!threadCount) return {};
+
+   // Create missing workers. The pointers must be stable before the first worker starts
+   if (workers.size() < threadCount) {
+      std::unique_lock lock(mutex);
+      unsigned first = workers.size();
+      for (unsigned index = first; index != threadCount; ++index) workers.push_back(new Worker());
+      for (unsigned index = first; index != threadCount; ++index) workers[index]->thread = std::thread([this, index] { workerMain(index); });
+   }
+
+   // Start the job and wait for it
+   std::unique_lock lock(mutex);
+   job = std::move(newJob);
+   active = threadCount;
+   running = threadCount;
+   barrier.reset(threadCount);
+   ++jobNumber;
+   jobStarted.notify_all();
+   jobFinished.wait(lock, [&] { return !running; });
+
+   auto start = workers[0]->start, stop = workers[0]->stop;
+   for (unsigned index = 1; index != threadCount; ++index) {
+      start = std::min(start, workers[index]->start);
+      stop = std::max(stop, workers[index]->stop);
+   }
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(stop - start);
+}
+
+WorkerPool& WorkerPool::get() {
+   static WorkerPool pool;
+   return pool;
+}
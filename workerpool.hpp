@@ -0,0 +1,85 @@
+#ifndef H_workerpool
+#define H_workerpool
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// The threads of the multithreaded measurements. The workers are created once and pinned to a CPU each. A run
+// wakes the first n workers, which wait at a spin barrier until all of them are ready, so that the timed region
+// starts at the same time on all threads and every thread runs under the full contention
+
+/// A barrier that spins instead of sleeping
+class SpinBarrier {
+   /// The number of threads that arrived in the current generation
+   std::atomic<unsigned> arrived{0};
+   /// The generation, incremented whenever all threads arrived
+   std::atomic<unsigned> generation{0};
+   /// The number of threads that take part
+   unsigned count = 0;
+
+   public:
+   /// Set the number of threads. Only allowed while no thread waits
+   void reset(unsigned newCount) { count = newCount; }
+   /// Wait until all threads arrived
+   void wait();
+};
+
+/// A pool of pinned worker threads
+class WorkerPool {
+   /// A worker
+   struct Worker {
+      /// The thread
+      std::thread thread;
+      /// The start and the end of the last job
+      std::chrono::steady_clock::time_point start, stop;
+   };
+
+   /// The workers
+   std::vector<Worker*> workers;
+   /// The current job
+   std::function<void(unsigned)> job;
+   /// The number of workers that run the current job
+   unsigned active = 0;
+   /// The number of the current job, incremented for every run
+   unsigned jobNumber = 0;
+   /// The number of workers that still run the current job
+   unsigned running = 0;
+   /// The CPUs of the workers, worker n runs on placement[n % size]. Empty if pinning is not supported
+   std::vector<unsigned> placement, defaultPlacement;
+   /// The number of the placement, incremented for every change
+   unsigned placementNumber = 0;
+   /// Shut down?
+   bool done = false;
+   /// Protects the job state
+   std::mutex mutex;
+   /// Signals a new job, and the end of a job
+   std::condition_variable jobStarted, jobFinished;
+   /// Synchronizes the start of the workers
+   SpinBarrier barrier;
+
+   /// The loop of a worker
+   void workerMain(unsigned id);
+
+   public:
+   /// Constructor. Places the workers on the CPUs the process may run on
+   WorkerPool();
+   /// Destructor
+   ~WorkerPool();
+
+   /// Pin the workers to the given CPUs, or to the default CPUs if empty. Takes effect with the next run
+   void setPlacement(std::vector<unsigned> cpus);
+   /// Change the default CPUs, and pin the workers to them. Takes effect with the next run
+   void setDefaultPlacement(std::vector<unsigned> cpus);
+   /// Run job(id) on threadCount workers. Returns the time from the first start to the last end
+   std::chrono::nanoseconds run(unsigned threadCount, std::function<void(unsigned)> job);
+
+   /// The pool shared by all measurements
+   static WorkerPool& get();
+};
+
+#endif